@@ -0,0 +1,83 @@
+#pragma once
+
+#include "result_writer.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Lock-free disjoint sets over document ids. Roots are only ever linked
+// under a smaller root, so each set ends up rooted at its smallest member
+// whatever order the unions arrive in; find() halves paths with CAS.
+class ConcurrentUnionFind {
+public:
+    explicit ConcurrentUnionFind(size_t size);
+
+    uint32_t find(uint32_t x);
+
+    // Returns false if the two were already in the same set
+    bool unite(uint32_t a, uint32_t b);
+
+    size_t size() const { return count; }
+
+private:
+    size_t count;
+    std::unique_ptr<std::atomic<uint32_t>[]> parent;
+};
+
+struct Cluster {
+    uint32_t representative = 0; // member with the highest summed similarity to the rest
+    std::vector<uint32_t> members; // ascending
+    uint64_t pairs = 0;          // linked pairs inside the cluster
+    double minScore = 0.0;
+    double meanScore = 0.0;
+    double maxScore = 0.0;
+};
+
+// Connected components of the "score >= threshold" graph, built as pairs are
+// scored without storing them: memory is O(documents) whatever the number of
+// pairs. addPair() may be called from many threads.
+class ClusterBuilder {
+public:
+    ClusterBuilder(size_t documents, double threshold);
+
+    // Pairs below the threshold are ignored; returns whether it was linked
+    bool addPair(uint32_t doc1, uint32_t doc2, double score);
+
+    // Components with at least two documents, ordered by smallest member.
+    // Must not run concurrently with addPair().
+    std::vector<Cluster> clusters();
+
+    double threshold() const { return minScore; }
+
+private:
+    // Per-document link statistics, updated with atomics
+    struct LinkStats {
+        std::atomic<uint64_t> pairs{0};      // links owned by this document (as doc1)
+        std::atomic<double> ownedSum{0.0};   // scores of those links
+        std::atomic<double> ownedMin{2.0};
+        std::atomic<double> ownedMax{-1.0};
+        std::atomic<double> totalScore{0.0}; // all links touching this document
+    };
+
+    double minScore;
+    ConcurrentUnionFind sets;
+    std::unique_ptr<LinkStats[]> links;
+};
+
+enum class ClusterFormat {
+    TEXT,   // one block per cluster
+    JSON,   // a single JSON array of cluster objects
+    NDJSON, // one JSON object per line
+    CSV     // one row per member: cluster,file[,representative,...]
+};
+
+// Statistics and representatives are included when `withStats` is set
+class ClusterWriter {
+public:
+    // Writes to `path`, or to stdout when `path` is empty or "-"
+    static void write(const std::vector<Cluster>& clusters, const std::vector<std::string>& names,
+                      ClusterFormat format, const std::string& path, bool withStats);
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#include "executor.hpp"
+#include "text_processor.hpp"
+#include "document_analyzer.hpp"
+#include "term_vector.hpp"
+#include "simhash.hpp"
+#include "inverted_index.hpp"
+#include "sketch.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+enum class Algorithm {
+    COSINE,
+    TFIDF,
+    JACCARD_CHAR,
+    JACCARD_WORD,
+    SIMHASH,
+    ALL
+};
+
+enum class SketchType {
+    NONE,
+    MINHASH,
+    HLL
+};
+
+// What is computed for each document and pair
+struct CompareOptions {
+    Algorithm algorithm = Algorithm::COSINE;
+    int shingleSize = 3;
+    SketchType sketch = SketchType::NONE;
+    double sketchError = 0.05;
+    bool exact = false;       // double-precision term maps instead of float32 vectors
+    size_t hashDims = 0;      // hashed dense cosine vectors when nonzero
+    bool corpusIdf = false;   // TF-IDF with IDF over the whole corpus
+    bool searchIndex = false; // with corpusIdf, index TF-IDF vectors for search()
+    bool analysis = false;    // document statistics and confidence levels
+    bool sentences = false;   // sentence-level matches
+
+    // Scoring cascade, off when negative. Stages run cheapest first, and a
+    // stage is skipped once upper bounds show the pair's combined score can
+    // no longer reach `cascade`, or its primaryScore() can no longer reach a
+    // nonzero `primaryThreshold` (pairs below it are of no use to the caller).
+    double cascade = -1.0;
+    double primaryThreshold = 0.0;
+};
+
+// Stages a cascade can skip. Score stages share the ScoreField bits.
+enum CascadeStage : unsigned {
+    STAGE_COSINE = 1u << 0,
+    STAGE_TFIDF = 1u << 1,
+    STAGE_JACCARD_CHAR = 1u << 2,
+    STAGE_JACCARD_WORD = 1u << 3,
+    STAGE_SENTENCES = 1u << 8
+};
+
+struct SimilarityResult {
+    double cosine = 0.0;
+    double tfidf = 0.0;
+    double jaccardChar = 0.0;
+    double jaccardWord = 0.0;
+    double jaccardCharMargin = 0.0; // 95% half-width when sketched
+    double jaccardWordMargin = 0.0;
+    double simhash = 0.0;
+    int hammingDistance = 0;
+    double duration = 0.0;
+    unsigned skipped = 0; // CascadeStage bits of stages that did not run
+    DocumentStats stats1;
+    DocumentStats stats2;
+    SimilarityConfidence confidence;
+    std::vector<std::pair<double, std::string>> sentenceSimilarities;
+};
+
+// Score used where a single value per pair is needed
+double primaryScore(const SimilarityResult& result, Algorithm algorithm);
+
+// Finalized Jaccard sketch of one document's shingles, with CompareOptions::sketch
+struct ShingleSketch {
+    std::optional<MinHashSketch> minHash;
+    std::optional<HyperLogLogSketch> hll;
+};
+
+// Everything about one document that does not depend on the other side of
+// a pair, built once when the document is added
+struct DocumentProfile {
+    std::string content;
+    std::vector<std::string> tokens;
+    std::unordered_map<std::string, double> tf;
+    std::vector<uint64_t> charShingles; // packed, sorted and deduplicated
+    std::vector<std::string> wordShingles; // sorted; only built ahead for large documents
+    ShingleSketch charSketch; // with sketch, which then drops tokens and content
+    ShingleSketch wordSketch;
+    TermVector termVector;    // unit-length tf, for cosine
+    HashedVector hashedVector; // with hashDims
+    TermVector tfidfVector;   // unit-length tf-idf, with corpusIdf
+    uint64_t fingerprint = 0; // SimHash, for Algorithm::SIMHASH
+    DocumentStats stats;
+};
+
+// A set of preprocessed documents that can be compared in batches without
+// re-tokenizing. Adding documents is not thread-safe; everything const is.
+class Corpus {
+public:
+    using DocumentId = uint32_t;
+
+    struct Comparison {
+        DocumentId doc1;
+        DocumentId doc2;
+        SimilarityResult result;
+    };
+
+    struct Match {
+        DocumentId document;
+        double score; // primaryScore() of the result
+        SimilarityResult result;
+    };
+
+    // `memory` backs the corpus's profile table
+    explicit Corpus(const CompareOptions& options = {},
+                    const TextProcessor& processor = TextProcessor(),
+                    std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+    DocumentId add(std::string_view content);
+    DocumentId add(DocumentProfile&& profile);
+
+    // Build a profile without adding it; safe to call from many threads.
+    // With an executor, documents over a megabyte are tokenized, counted and
+    // shingled in pieces on it, with the same result as without one.
+    DocumentProfile buildProfile(std::string&& content, Executor* executor = nullptr) const;
+
+    // Renumber terms in sorted order and recompute corpus-wide IDF vectors.
+    // Needed with corpusIdf before comparing, whenever documents were added
+    // since the last call. Without it, term ids (and so float rounding in
+    // cosine sums) depend on the order threads interned terms in.
+    // Profiles built but not added become invalid.
+    void finalize();
+
+    size_t size() const { return profiles.size(); }
+    const DocumentProfile& profile(DocumentId id) const { return profiles.at(id); }
+    const CompareOptions& compareOptions() const { return options; }
+    const Vocabulary& vocabulary() const { return *terms; }
+
+    SimilarityResult compare(DocumentId doc1, DocumentId doc2) const;
+    SimilarityResult compare(const DocumentProfile& doc1, const DocumentProfile& doc2) const;
+
+    // Every pair of ids1 x ids2 except a document with itself, in row-major
+    // order. Without an executor the calling thread does all the work.
+    std::vector<Comparison> compare(const std::vector<DocumentId>& ids1,
+                                    const std::vector<DocumentId>& ids2,
+                                    Executor* executor = nullptr) const;
+
+    // Every pair of queries x documents except a document with itself, for
+    // when only that block is wanted. Queries go a batch at a time, and each
+    // document is compared with the whole batch in turn, so its profile is
+    // read from memory once per batch instead of once per query. `visit`
+    // runs on the calling thread, batch by batch, then in document order,
+    // then in query order.
+    void compareBatched(const std::vector<DocumentId>& queries,
+                        const std::vector<DocumentId>& documents, size_t batchSize,
+                        const std::function<void(const Comparison&)>& visit,
+                        Executor* executor = nullptr) const;
+
+    // The k documents most similar to `query` by primaryScore(), best first
+    std::vector<Match> topK(std::string_view query, size_t k,
+                            Executor* executor = nullptr) const;
+
+    // Exact top-k TF-IDF cosine matches for `query` from the inverted index,
+    // best first; needs searchIndex. Only documents sharing a term with the
+    // query can match.
+    std::vector<Match> search(std::string_view query, size_t k,
+                              SearchStats* stats = nullptr) const;
+    
+    // SimHash near-duplicate pairs among all documents (Algorithm::SIMHASH)
+    std::vector<NearDuplicate> nearDuplicates(int maxDistance) const;
+
+private:
+    CompareOptions options;
+    TextProcessor processor;
+    std::pmr::vector<DocumentProfile> profiles;
+    std::unique_ptr<Vocabulary> terms; // shared by every profile's term vectors
+    std::unordered_map<std::string, double> idf;
+    std::unique_ptr<InvertedIndex> index;
+    bool idfStale = false;
+
+    void checkFinalized() const;
+    // With `query`, term vectors only look terms up and never intern them
+    DocumentProfile buildProfile(std::string&& content, Executor* executor, bool query) const;
+};
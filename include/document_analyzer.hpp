@@ -1,5 +1,6 @@
 #pragma once
 
+#include "executor.hpp"
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -27,6 +28,16 @@ public:
     static DocumentStats analyzeDocument(const std::string& content, 
                                        const std::vector<std::string>& tokens);
     
+    // The same statistics, gathered in parallel from pieces of at least
+    // `chunkSize` bytes and ranges of tokens
+    static DocumentStats analyzeDocument(const std::string& content,
+                                       const std::vector<std::string>& tokens,
+                                       Executor& executor, size_t chunkSize);
+    
+    // Weighted combination of the four scores that confidence levels are
+    // based on; cosine and character Jaccard weigh the most
+    static double combinedScore(double cosine, double tfidf, double jaccardChar, double jaccardWord);
+    
     // Determine confidence level and interpretation
     static SimilarityConfidence analyzeSimilarityConfidence(
         double cosine, double tfidf, double jaccardChar, double jaccardWord);
@@ -35,6 +46,10 @@ public:
     static std::vector<std::pair<double, std::string>> analyzeSentenceSimilarity(
         const std::string& content1, const std::string& content2);
     
+    // Sentences as (byte offset, length) spans of `text`, split after runs of
+    // . ! ? and trimmed; fragments of 5 characters or less are dropped
+    static std::vector<std::pair<size_t, size_t>> findSentences(const std::string& text);
+    
     // Generate analysis summary
     static std::string generateAnalysisSummary(
         const DocumentStats& stats1, const DocumentStats& stats2,
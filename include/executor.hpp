@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// Runs batches of independent tasks. Implement it to route Corpus work onto
+// an existing thread pool; ThreadExecutor is a simple default.
+class Executor {
+public:
+    virtual ~Executor() = default;
+
+    // Call task(i) for every i in [0, count) and return once all are done
+    virtual void parallelFor(size_t count, const std::function<void(size_t)>& task) = 0;
+};
+
+class ThreadExecutor : public Executor {
+public:
+    explicit ThreadExecutor(size_t threads = 0); // 0 = all cores
+
+    void parallelFor(size_t count, const std::function<void(size_t)>& task) override;
+
+private:
+    size_t threads;
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ExternalOptions {
+    size_t maxMemory = size_t(1) << 30; // bytes for buffers across all phases
+    std::string tempDir;                // empty = the system temp directory
+    bool showProgress = true;           // progress and ETA on stderr
+    // Shingles in more documents than this are dropped, and Jaccard is then
+    // over the remaining shingles of each document; 0 = keep every shingle
+    size_t maxDocumentFrequency = 0;
+};
+
+// Rate-limited "phase: done/total (pct) ETA" line on stderr
+class ProgressMeter {
+public:
+    ProgressMeter(const char* phase, uint64_t total, bool enabled);
+
+    // Redraws at most twice a second; `final` always redraws and ends the line
+    void update(uint64_t done, bool final = false);
+
+private:
+    const char* phase;
+    uint64_t total;
+    bool enabled;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point lastPrint;
+};
+
+// All-pairs Jaccard over shingle sets that do not fit in memory. Documents
+// are reduced to (shingle, doc) postings spilled to disk in sorted runs; a
+// k-way merge groups postings by shingle, every group emits its document
+// pairs into sorted pair-count runs, and a final merge sums each pair's
+// overlap and turns it into Jaccard using the recorded set sizes. A group of
+// g documents emits g(g-1)/2 pairs, so boilerplate shingles shared by much of
+// the corpus can be cut off with ExternalOptions::maxDocumentFrequency.
+class ExternalJaccard {
+public:
+    ExternalJaccard(size_t documentCount, const ExternalOptions& options);
+    ~ExternalJaccard(); // removes the spill directory
+
+    ExternalJaccard(const ExternalJaccard&) = delete;
+    ExternalJaccard& operator=(const ExternalJaccard&) = delete;
+
+    // Thread-safe. `shingles` must be sorted and unique.
+    void addDocument(uint32_t doc, const std::vector<uint64_t>& shingles);
+
+    using Visitor = std::function<void(uint32_t doc1, uint32_t doc2, double jaccard)>;
+
+    // Visit every pair sharing at least one shingle, ordered by (doc1, doc2)
+    // with doc1 < doc2. Pairs with nothing in common have Jaccard 0 and are
+    // not visited.
+    void run(const Visitor& visit);
+
+    struct Posting {
+        uint64_t shingle;
+        uint32_t doc;
+        uint32_t reserved;
+
+        bool operator<(const Posting& other) const {
+            return shingle != other.shingle ? shingle < other.shingle : doc < other.doc;
+        }
+        bool absorb(const Posting&) { return false; }
+    };
+
+    struct PairCount {
+        uint64_t pair; // doc1 << 32 | doc2
+        uint64_t count;
+
+        bool operator<(const PairCount& other) const { return pair < other.pair; }
+        bool absorb(const PairCount& other) {
+            if (other.pair != pair) return false;
+            count += other.count;
+            return true;
+        }
+    };
+
+private:
+    ExternalOptions options;
+    std::string directory;
+    std::vector<uint32_t> sizes;
+    std::vector<Posting> postings;
+    std::vector<std::string> postingRuns;
+    uint64_t totalPostings = 0;
+    uint64_t documentsAdded = 0;
+    ProgressMeter addProgress;
+    size_t runCounter = 0;
+    std::mutex bufferMutex;
+    std::mutex spillMutex;
+
+    std::string nextRunPath(const char* kind);
+    void spillPostings(std::vector<Posting>& buffer);
+    std::vector<std::string> generatePairRuns(uint64_t& pairRecords);
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct IngestOptions {
+    size_t readers = 2;                     // prefetching reader threads
+    size_t workers = 0;                     // 0 = hardware concurrency
+    size_t queueCapacity = 64;              // documents between the stages
+    size_t maxBytesInFlight = 256u << 20;   // read but not yet processed
+};
+
+// Two-stage ingest: reader threads prefetch file contents into a bounded
+// lock-free queue and worker threads turn them into whatever the caller
+// needs. Readers stall when the queue is full or the unprocessed bytes
+// exceed the budget, so memory stays bounded and ingest runs at the speed of
+// the slower of disk and CPU.
+class IngestPipeline {
+public:
+    // Called concurrently from worker threads with the document's position
+    // in the input list and its contents
+    using Processor = std::function<void(size_t index, std::string&& content)>;
+
+    explicit IngestPipeline(const IngestOptions& options = IngestOptions());
+
+    // Process every file; rethrows the first error from any stage
+    void run(const std::vector<std::string>& files, const Processor& process) const;
+
+    static std::string readFile(const std::string& filename);
+
+    // Expand inputs into a file list: directories are walked recursively in
+    // sorted order, and each list file ("-" for stdin) names one path per line
+    static std::vector<std::string> expandInputs(
+        const std::vector<std::string>& inputs,
+        const std::vector<std::string>& fileLists);
+
+private:
+    IngestOptions options;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "term_vector.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Work done by one InvertedIndex::search()
+struct SearchStats {
+    uint64_t postings = 0;        // in the lists of the query's terms
+    uint64_t postingsDecoded = 0; // the rest were skipped a block at a time
+    uint64_t documentsScored = 0; // exactly rescored from their term vectors
+};
+
+// Term -> (document, weight) postings over unit-length term vectors, for
+// exact top-K cosine search with block-max WAND pruning.
+//
+// Each list is split into blocks of 128 postings. A posting is a varint
+// document delta followed by its weight quantized to one byte, rounded up
+// against the list's maximum weight. A skip entry per block holds the
+// block's last document, byte offset and largest weight, so cursors jump
+// over whole blocks that cannot lift a document into the top K.
+// Quantized weights only ever overestimate, which makes every bound an
+// upper bound: documents that pass are rescored exactly from their vectors,
+// and the result equals a brute-force scan.
+class InvertedIndex {
+public:
+    struct Hit {
+        uint32_t document;
+        double score;
+    };
+
+    // The vectors are kept by pointer for rescoring and must outlive the
+    // index; all must be keyed by the same vocabulary
+    explicit InvertedIndex(const std::vector<const TermVector*>& documents);
+
+    // The k documents with the highest cosine to `query`, best first, ties to
+    // the smaller document; documents sharing no term with it never match
+    std::vector<Hit> search(const TermVector& query, size_t k, SearchStats* stats = nullptr) const;
+
+    size_t documentCount() const { return documents.size(); }
+    size_t postingBytes() const { return bytes.size(); }
+
+private:
+    struct Skip {
+        uint32_t lastDocument;
+        uint32_t offset;   // into `bytes`, where the block starts
+        uint8_t maxWeight; // quantized, like the postings
+    };
+
+    struct PostingList {
+        uint32_t count = 0;
+        uint32_t firstSkip = 0; // into `skips`
+        float maxWeight = 0.0f;
+    };
+
+    class Cursor;
+
+    std::vector<const TermVector*> documents;
+    std::vector<PostingList> lists; // by term id
+    std::vector<Skip> skips;
+    std::vector<uint8_t> bytes;
+};
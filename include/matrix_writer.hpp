@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+enum class MatrixDtype {
+    FLOAT16,
+    FLOAT32
+};
+
+enum class MatrixLayout {
+    DENSE_UPPER, // strict upper triangle, row-major
+    CSR          // compressed sparse rows, upper triangle only
+};
+
+// Fixed 64-byte header at the start of every matrix file. All fields are
+// little-endian and every section offset is 64-byte aligned, so each array
+// can be mapped directly, e.g. with numpy.memmap(path, dtype, offset=...).
+//
+//   DENSE_UPPER: data[n*(n-1)/2] at dataOffset, ordered like
+//                numpy.triu_indices(n, 1)
+//   CSR:         indptr uint64[n+1] at indptrOffset,
+//                indices uint32[nnz] at indicesOffset,
+//                data[nnz] at dataOffset
+struct MatrixFileHeader {
+    char magic[4];          // "STXM"
+    uint32_t version;
+    uint32_t layout;        // MatrixLayout
+    uint32_t itemSize;      // 2 for float16, 4 for float32
+    uint64_t n;             // number of documents
+    uint64_t nnz;           // stored values
+    uint64_t dataOffset;
+    uint64_t indicesOffset; // CSR only, 0 otherwise
+    uint64_t indptrOffset;  // CSR only, 0 otherwise
+    float threshold;        // CSR keeps values >= threshold
+    uint32_t reserved;
+};
+
+static_assert(sizeof(MatrixFileHeader) == 64, "matrix header must stay 64 bytes");
+
+// Streams pair scores into a memory-mapped matrix file. Pairs may arrive in
+// any order; they are collected into tiles and applied to the mapping (dense)
+// or spilled to a side file (CSR) one tile at a time, so memory use stays at
+// one tile regardless of the matrix size.
+class MatrixWriter {
+public:
+    // A positive threshold selects the CSR layout, otherwise dense
+    MatrixWriter(const std::string& path, uint32_t documentCount,
+                 MatrixDtype dtype, double threshold);
+    ~MatrixWriter();
+
+    MatrixWriter(const MatrixWriter&) = delete;
+    MatrixWriter& operator=(const MatrixWriter&) = delete;
+
+    // Record the score of pair (i, j), i < j
+    void set(uint32_t i, uint32_t j, double value);
+
+    // Write remaining tiles, finalize the layout and unmap the file. Throws
+    // std::runtime_error if the file could not be flushed to disk.
+    void finish();
+
+    // Position of pair (i, j), i < j, in the dense upper-triangular layout
+    static uint64_t denseIndex(uint64_t n, uint64_t i, uint64_t j);
+
+    // IEEE 754 binary32 to binary16, round to nearest even
+    static uint16_t toHalf(float value);
+
+private:
+    struct Entry {
+        uint32_t row;
+        uint32_t col;
+        float value;
+    };
+
+    void flushTile();
+    void storeValue(unsigned char* data, uint64_t index, float value) const;
+    void finishDense();
+    void finishSparse();
+    void mapFile(uint64_t size);
+    bool unmapFile(); // false if flushing or closing the file failed
+
+    std::string path;
+    std::string spillPath;
+    uint32_t n;
+    MatrixDtype dtype;
+    MatrixLayout layout;
+    float threshold;
+    bool finished = false;
+
+    std::vector<Entry> tile;
+    std::FILE* spill = nullptr;
+    uint64_t spilled = 0;
+
+    int fd = -1;
+    unsigned char* mapping = nullptr;
+    uint64_t mappedSize = 0;
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Bit flags selecting which scores a writer emits
+enum ScoreField : unsigned {
+    SCORE_COSINE = 1u << 0,
+    SCORE_TFIDF = 1u << 1,
+    SCORE_JACCARD_CHAR = 1u << 2,
+    SCORE_JACCARD_WORD = 1u << 3,
+    SCORE_SIMHASH = 1u << 4
+};
+
+enum class RecordFormat {
+    JSON,   // a single JSON array of pair objects
+    NDJSON, // one JSON object per line
+    CSV,    // header row plus one row per pair
+    BINARY  // compact fixed-size records, see BinaryResultWriter
+};
+
+// One scored document pair, referencing documents by index
+struct PairRecord {
+    uint32_t doc1 = 0;
+    uint32_t doc2 = 0;
+    double cosine = 0.0;
+    double tfidf = 0.0;
+    double jaccardChar = 0.0;
+    double jaccardWord = 0.0;
+    double simhash = 0.0;
+    double duration = 0.0;
+    unsigned skipped = 0; // ScoreField bits of scores a cascade did not compute
+};
+
+struct WriterOptions {
+    unsigned fields = SCORE_COSINE;
+    double threshold = 0.0;
+    bool showTimings = false;
+    size_t bufferSize = 1 << 20;
+};
+
+// Buffered result writer. Records below the threshold are dropped before any
+// formatting happens; accepted records are formatted into a large buffer that
+// is handed to a dedicated writer thread once full, so formatting and I/O
+// overlap.
+class ResultWriter {
+public:
+    // Writes to `path`, or to stdout when `path` is empty or "-"
+    static std::unique_ptr<ResultWriter> create(
+        RecordFormat format, const std::string& path,
+        const std::vector<std::string>& names, const WriterOptions& options);
+
+    virtual ~ResultWriter();
+
+    ResultWriter(const ResultWriter&) = delete;
+    ResultWriter& operator=(const ResultWriter&) = delete;
+
+    // Returns false if the record was filtered out by the threshold
+    bool write(const PairRecord& record);
+
+    // Emit the footer, flush all buffers and join the writer thread; throws
+    // if any write failed
+    void finish();
+
+    // Highest enabled score of a record, as used for threshold filtering
+    static double maxScore(const PairRecord& record, unsigned fields);
+
+    // First enabled score in ScoreField bit order, as used for ranking
+    static double primaryScore(const PairRecord& record, unsigned fields);
+
+protected:
+    ResultWriter(const std::vector<std::string>& names, const WriterOptions& options);
+
+    // Must be called by derived constructors once formatting can start
+    void begin(const std::string& path, bool binary);
+
+    virtual void formatHeader(std::string& out) { (void)out; }
+    virtual void formatRecord(const PairRecord& record, std::string& out) = 0;
+    virtual void formatFooter(std::string& out) { (void)out; }
+
+    std::vector<std::string> names;
+    WriterOptions options;
+
+private:
+    void submit();
+    void writerLoop();
+    void shutdown(bool withFooter);
+
+    std::FILE* file = nullptr;
+    bool ownsFile = false;
+    bool finished = false;
+    bool writeFailed = false; // set by the writer thread, read after joining it
+
+    std::string current;
+    std::string pending;
+    bool hasPending = false;
+    bool stopping = false;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread writerThread;
+};
+
+// Appends a number with a fixed number of decimals using std::to_chars
+void appendFixed(std::string& out, double value, int precision);
+
+// Appends `text` as a CSV field, quoted only when it needs to be
+void appendCsvField(std::string& out, const std::string& text);
+
+// Appends `text` as a quoted JSON string
+void appendJsonString(std::string& out, const std::string& text);
+
+// Binary layout, little-endian on every host:
+//   char[4]  magic "STXR"
+//   uint32   version
+//   uint32   field mask (ScoreField bits)
+//   uint32   document count
+//   per document: uint32 name length, name bytes
+//   records: uint32 doc1, uint32 doc2, one float32 per enabled field
+//            in ScoreField bit order (NaN for a skipped score)
+struct BinaryResultHeader {
+    unsigned fields = 0;
+    std::vector<std::string> names;
+};
+
+class BinaryResultReader {
+public:
+    explicit BinaryResultReader(const std::string& path);
+    ~BinaryResultReader();
+
+    BinaryResultReader(const BinaryResultReader&) = delete;
+    BinaryResultReader& operator=(const BinaryResultReader&) = delete;
+
+    const BinaryResultHeader& header() const { return hdr; }
+
+    // Reads the next record; returns false at end of file
+    bool next(PairRecord& record);
+
+private:
+    std::FILE* file = nullptr;
+    BinaryResultHeader hdr;
+    size_t fieldCount = 0;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "text_processor.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct SentenceIndexOptions {
+    uint32_t bands = 16;         // LSH bands; more finds lower similarities
+    uint32_t rows = 4;           // MinHash values per band; more is stricter
+    double minSimilarity = 0.5;  // word-set Jaccard a source needs
+    size_t maxSources = 3;       // per query sentence
+    size_t minLength = 10;       // shorter sentences are neither indexed nor queried
+};
+
+// A stored sentence a query sentence may have come from
+struct SentenceSource {
+    uint32_t document;
+    size_t offset; // bytes into that document
+    size_t length;
+    double similarity;
+};
+
+struct SentenceMatch {
+    size_t offset; // bytes into the query
+    size_t length;
+    std::vector<SentenceSource> sources; // best first
+};
+
+// Sentence-level provenance over a whole corpus. Each sentence's word set
+// gets a MinHash signature that is cut into bands, and sentences sharing any
+// band land in the same bucket, so a query only scores the few stored
+// sentences it collides with instead of every sentence in the corpus.
+// Candidates are then ranked by exact word-set Jaccard.
+class SentenceIndex {
+public:
+    explicit SentenceIndex(const SentenceIndexOptions& options = SentenceIndexOptions(),
+                           const TextProcessor& processor = TextProcessor());
+
+    // Index every sentence of a document; safe to call from many threads
+    void addDocument(uint32_t document, const std::string& content);
+
+    // Query sentences with at least one source, in query order
+    std::vector<SentenceMatch> query(const std::string& content) const;
+
+    size_t sentenceCount() const { return sentences.size(); }
+
+private:
+    struct Sentence {
+        uint32_t document;
+        uint32_t length;
+        size_t offset;
+        size_t wordsBegin; // range of `words`
+        size_t wordsEnd;
+    };
+
+    // One sentence's sorted word hashes and band keys
+    struct Signature {
+        size_t offset;
+        size_t length;
+        std::vector<uint64_t> words;
+        std::vector<uint64_t> bandKeys;
+    };
+
+    std::vector<Signature> signatures(const std::string& content) const;
+
+    SentenceIndexOptions options;
+    TextProcessor processor;
+    std::vector<uint64_t> seeds; // one per MinHash value
+
+    std::mutex mutex; // guards everything below while adding
+    std::vector<Sentence> sentences;
+    std::vector<uint64_t> words;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> buckets; // band key -> sentences
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "result_writer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// One of `count` independent slices of an all-pairs job, 0 <= index < count
+struct Shard {
+    uint32_t index = 0;
+    uint32_t count = 1;
+
+    // Parses "i/n"; throws std::invalid_argument when malformed
+    static Shard parse(const std::string& text);
+
+    // Pairs found by a search (SimHash candidates) are assigned by hash,
+    // since their number is not known up front
+    bool owns(uint32_t doc1, uint32_t doc2) const;
+};
+
+// The pair triangle (i < j, row-major) numbered 0 .. n(n-1)/2 - 1 and cut
+// into equal contiguous ranges, one per shard
+class PairPartition {
+public:
+    static uint64_t pairCount(uint64_t documents);
+
+    // Linear index range [first, second) of a shard
+    static std::pair<uint64_t, uint64_t> range(uint64_t documents, const Shard& shard);
+
+    // Pair (i, j) with the given linear index
+    static std::pair<uint32_t, uint32_t> pairAt(uint64_t documents, uint64_t index);
+
+    template <typename Visitor>
+    static void forEachPair(uint64_t documents, const Shard& shard, Visitor&& visit);
+
+private:
+    static uint64_t rowStart(uint64_t documents, uint64_t row);
+};
+
+template <typename Visitor>
+void PairPartition::forEachPair(uint64_t documents, const Shard& shard, Visitor&& visit) {
+    auto [first, last] = range(documents, shard);
+    if (first == last) return;
+
+    auto [i, j] = pairAt(documents, first);
+    for (uint64_t index = first; index < last; ++index) {
+        visit(i, j);
+        if (++j == documents) {
+            ++i;
+            j = i + 1;
+        }
+    }
+}
+
+struct MergeOptions {
+    RecordFormat format = RecordFormat::BINARY;
+    std::string outputFile; // stdout when empty
+    double threshold = 0.0;
+    size_t topK = 0;        // 0 = keep every pair
+};
+
+// Combines binary result files written by shards of the same job into one
+// result in the order a single run produces: by (doc1, doc2), or best first
+// with a top-K. Shards written with a top-K are best first rather than
+// sorted, and only merge with a top-K; otherwise an unsorted shard throws
+// std::runtime_error. Returns the number of pairs written.
+class ShardMerger {
+public:
+    static size_t merge(const std::vector<std::string>& inputs, const MergeOptions& options);
+};
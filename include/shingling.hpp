@@ -1,6 +1,10 @@
 #pragma once
 
+#include "executor.hpp"
+#include "utf8.hpp"
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <set>
 #include <unordered_set>
@@ -21,7 +25,117 @@ public:
     
     // Generate word-level shingles
     static std::set<std::string> generateWordShingles(const std::vector<std::string>& tokens, int w = 3);
+    
+    // Character shingles as sorted, deduplicated 64-bit keys. An ASCII shingle
+    // of up to 8 characters is packed exactly into its key; longer or
+    // non-ASCII shingles use a 64-bit hash with the top bit set, which keeps
+    // the two key spaces disjoint.
+    static std::vector<uint64_t> generatePackedCharacterShingles(const std::string& text, int w = 5);
+    
+    // The same keys, from pieces of at least `chunkSize` bytes shingled in
+    // parallel; each piece also reads the w - 1 characters after it, so
+    // every shingle across a cut is generated exactly once
+    static std::vector<uint64_t> generatePackedCharacterShingles(const std::string& text, int w,
+                                                                 Executor& executor, size_t chunkSize);
+    
+    // The set generateWordShingles() builds, as a sorted vector
+    static std::vector<std::string> generateSortedWordShingles(const std::vector<std::string>& tokens, int w = 3);
+    
+    // The same shingles, from ranges of `chunkTokens` starting tokens
+    // generated in parallel and merged
+    static std::vector<std::string> generateSortedWordShingles(const std::vector<std::string>& tokens, int w,
+                                                               Executor& executor, size_t chunkTokens);
+    
+    // Word shingles as sorted, deduplicated 64-bit hashes
+    static std::vector<uint64_t> generateHashedWordShingles(const std::vector<std::string>& tokens, int w = 3);
+    
+    // Jaccard similarity of two sorted, deduplicated key vectors
+    static double calculateJaccardSimilarity(
+        const std::vector<uint64_t>& shingles1,
+        const std::vector<uint64_t>& shingles2
+    );
+    static double calculateJaccardSimilarity(
+        const std::vector<std::string>& shingles1,
+        const std::vector<std::string>& shingles2
+    );
+    
+    // LSD radix sort followed by deduplication
+    static void sortUnique(std::vector<uint64_t>& keys);
+    
+    // Stream the shingles of the sets above without building them;
+    // duplicates are visited once per occurrence
+    template <typename Visitor>
+    static void forEachCharacterShingle(const std::string& text, int w, Visitor&& visit);
+    
+    template <typename Visitor>
+    static void forEachWordShingle(const std::vector<std::string>& tokens, int w, Visitor&& visit);
 
 private:
-    static std::string normalizeText(const std::string& text);
-};
\ No newline at end of file
+    static std::string normalizeText(std::string_view text);
+    
+    template <typename Visitor>
+    static void forEachCharacterShingleOf(std::string_view normalized, int w, Visitor&& visit);
+    
+    template <int W>
+    static void packAsciiShingles(std::string_view normalized, std::vector<uint64_t>& keys);
+    static void packGenericShingles(std::string_view normalized, int w, std::vector<uint64_t>& keys);
+    static void packShingles(std::string_view normalized, int w, bool ascii, std::vector<uint64_t>& keys);
+};
+
+template <typename Visitor>
+void ShinglingCalculator::forEachCharacterShingle(const std::string& text, int w, Visitor&& visit) {
+    std::string normalized = normalizeText(text);
+    forEachCharacterShingleOf(normalized, w, visit);
+}
+
+template <typename Visitor>
+void ShinglingCalculator::forEachCharacterShingleOf(std::string_view view, int w, Visitor&& visit) {
+    // Shingles are w code points; byte offsets of each code point (plus the
+    // end) are only needed when the text is not pure ASCII
+    std::vector<size_t> starts;
+    bool ascii = Utf8::isAscii(view);
+    if (!ascii) {
+        for (size_t i = 0; i < view.size(); ++i) {
+            if ((static_cast<unsigned char>(view[i]) & 0xC0) != 0x80) starts.push_back(i);
+        }
+        starts.push_back(view.size());
+    }
+    size_t length = ascii ? view.size() : starts.size() - 1;
+    
+    if (length < static_cast<size_t>(w)) {
+        visit(view);
+        return;
+    }
+    
+    for (size_t i = 0; i <= length - w; ++i) {
+        std::string_view shingle = ascii ? view.substr(i, w)
+                                         : view.substr(starts[i], starts[i + w] - starts[i]);
+        // Skip shingles that are all spaces
+        if (shingle.find_first_not_of(' ') != std::string_view::npos) {
+            visit(shingle);
+        }
+    }
+}
+
+template <typename Visitor>
+void ShinglingCalculator::forEachWordShingle(const std::vector<std::string>& tokens, int w, Visitor&& visit) {
+    std::string shingle;
+    
+    if (tokens.size() < static_cast<size_t>(w)) {
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            if (i > 0) shingle += " ";
+            shingle += tokens[i];
+        }
+        visit(std::string_view(shingle));
+        return;
+    }
+    
+    for (size_t i = 0; i <= tokens.size() - w; ++i) {
+        shingle.clear();
+        for (int j = 0; j < w; ++j) {
+            if (j > 0) shingle += " ";
+            shingle += tokens[i + j];
+        }
+        visit(std::string_view(shingle));
+    }
+}
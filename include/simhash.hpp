@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+struct NearDuplicate {
+    uint32_t doc1 = 0;
+    uint32_t doc2 = 0;
+    int distance = 0;
+};
+
+class SimHash {
+public:
+    // 64-bit SimHash fingerprint of a term frequency map, weighting each
+    // term's hash bits by its frequency
+    static uint64_t fingerprint(const std::unordered_map<std::string, double>& tf);
+
+    static int hammingDistance(uint64_t a, uint64_t b) {
+        return __builtin_popcountll(a ^ b);
+    }
+
+    // Similarity in [0, 1] derived from the Hamming distance
+    static double similarity(uint64_t a, uint64_t b) {
+        return 1.0 - hammingDistance(a, b) / 64.0;
+    }
+
+    // All pairs within maxDistance bits, from a SimHashIndex over the
+    // fingerprints (8 + 4 * (maxDistance + 1) bytes per document)
+    static std::vector<NearDuplicate> findNearDuplicates(
+        const std::vector<uint64_t>& fingerprints, int maxDistance);
+
+    static uint64_t hashTerm(const std::string& term);
+};
+
+// Permuted-table index for Hamming-distance queries. The 64 bits are split
+// into maxDistance + 1 blocks; by pigeonhole, two fingerprints within
+// maxDistance bits agree exactly on at least one block, so each table only
+// has to scan the documents sharing one block value with the query.
+class SimHashIndex {
+public:
+    SimHashIndex(std::vector<uint64_t> fingerprints, int maxDistance);
+
+    // Documents within maxDistance of `fingerprint`, sorted by document id
+    std::vector<std::pair<uint32_t, int>> query(uint64_t fingerprint) const;
+
+    // Every pair of indexed documents within maxDistance, each once with
+    // doc1 < doc2, sorted by (doc1, doc2)
+    std::vector<NearDuplicate> pairs() const;
+
+    size_t size() const { return fingerprints.size(); }
+
+    // Bit mask of block `b` when splitting 64 bits into `blockCount` blocks
+    static uint64_t blockMask(int b, int blockCount);
+
+private:
+    std::vector<uint64_t> fingerprints;
+    int maxDistance;
+    std::vector<uint64_t> masks;
+    std::vector<std::vector<uint32_t>> tables; // ids sorted by masked block
+};
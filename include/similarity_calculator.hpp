@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include "term_vector.hpp"
 
 class SimilarityCalculator {
 public:
@@ -12,6 +13,10 @@ public:
         const std::unordered_map<std::string, double>& tf2
     );
     
+    // Cosine of two prebuilt unit vectors: a sparse merge or a dense dot product
+    static double calculateCosineSimilarity(const TermVector& v1, const TermVector& v2);
+    static double calculateCosineSimilarity(const HashedVector& v1, const HashedVector& v2);
+    
     // Calculate TF-IDF weighted cosine similarity
     static double calculateTfIdfCosineSimilarity(
         const std::unordered_map<std::string, double>& tf1,
@@ -23,6 +28,9 @@ public:
     static std::unordered_map<std::string, double> calculateIdf(
         const std::vector<std::unordered_map<std::string, double>>& documents
     );
+    static std::unordered_map<std::string, double> calculateIdf(
+        const std::vector<const std::unordered_map<std::string, double>*>& documents
+    );
 
 private:
     // Helper function to calculate vector magnitude
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A Jaccard estimate with its 95% confidence interval
+struct JaccardEstimate {
+    double value = 0.0;
+    double lower = 0.0;
+    double upper = 0.0;
+};
+
+// b-bit one-permutation MinHash. Each shingle hash is routed to one of k
+// bins, which keeps the minimum hash it has seen; empty bins are filled by
+// optimal densification so sparse documents stay comparable. Only the low b
+// bits of each bin are kept, so a sketch takes k * b / 8 bytes.
+class MinHashSketch {
+public:
+    MinHashSketch(uint32_t bins, uint32_t bits);
+
+    // Smallest sketch whose 95% interval half-width stays below `error`
+    static MinHashSketch forError(double error, uint32_t bits = 8);
+
+    void add(uint64_t hash);
+
+    // Densify and truncate to b bits; further add() calls are rejected
+    void finalize();
+
+    static JaccardEstimate estimateJaccard(const MinHashSketch& a, const MinHashSketch& b);
+
+    std::string serialize() const;
+    static MinHashSketch deserialize(const std::string& data);
+
+    uint32_t bins() const { return binCount; }
+    uint32_t bits() const { return bitCount; }
+    bool empty() const { return isEmpty; }
+
+private:
+    uint32_t valueAt(uint32_t bin) const;
+
+    uint32_t binCount;
+    uint32_t bitCount;
+    bool isEmpty = true;
+    bool finalized = false;
+    std::vector<uint64_t> minimums;  // while building
+    std::vector<uint8_t> packed;     // after finalize()
+};
+
+// HyperLogLog cardinality sketch. Jaccard is estimated from the estimated
+// sizes of both sets and of their union (merged registers).
+class HyperLogLogSketch {
+public:
+    explicit HyperLogLogSketch(uint32_t precision);
+
+    // Smallest sketch whose relative cardinality error is below `error`
+    static HyperLogLogSketch forError(double error);
+
+    void add(uint64_t hash);
+    void merge(const HyperLogLogSketch& other);
+    double cardinality() const;
+
+    static JaccardEstimate estimateJaccard(const HyperLogLogSketch& a, const HyperLogLogSketch& b);
+
+    std::string serialize() const;
+    static HyperLogLogSketch deserialize(const std::string& data);
+
+    uint32_t precision() const { return precisionBits; }
+
+private:
+    uint32_t precisionBits;
+    std::vector<uint8_t> registers;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "vocabulary.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Sparse document vector with its norm divided out once at build time:
+// term ids from a shared Vocabulary sorted ascending, and float32 weights of
+// unit L2 length. Cosine between two vectors is then a plain dot product,
+// valid only between vectors keyed by the same vocabulary.
+struct TermVector {
+    std::vector<uint32_t> keys;
+    std::vector<float> weights;
+    double norm = 0.0; // L2 norm of the weights before normalization
+
+    static TermVector fromTermFrequencies(const std::unordered_map<std::string, double>& tf,
+                                          Vocabulary& vocabulary);
+    static TermVector fromTfIdf(const std::unordered_map<std::string, double>& tf,
+                                const std::unordered_map<std::string, double>& idf,
+                                Vocabulary& vocabulary);
+
+    // Lookup-only versions for queries: terms the vocabulary lacks are left
+    // out of the keys but still count toward the norm, so cosine against
+    // interned vectors is unchanged and the vocabulary is never modified
+    static TermVector fromKnownTermFrequencies(const std::unordered_map<std::string, double>& tf,
+                                               const Vocabulary& vocabulary);
+    static TermVector fromKnownTfIdf(const std::unordered_map<std::string, double>& tf,
+                                     const std::unordered_map<std::string, double>& idf,
+                                     const Vocabulary& vocabulary);
+
+    // Map keys through the old -> new ids from Vocabulary::finalize()
+    void renumber(const std::vector<uint32_t>& ids);
+};
+
+// Dense float32 vector of a fixed dimension, built by hashing terms into
+// buckets with a random sign so collisions cancel out on average. Also unit
+// length, and compared with SIMD dot product kernels.
+struct HashedVector {
+    std::vector<float> values;
+
+    static HashedVector fromTermFrequencies(const std::unordered_map<std::string, double>& tf,
+                                            size_t dimensions);
+};
+
+class VectorKernels {
+public:
+    // Dot product of two float arrays; uses AVX2/FMA when the CPU has it
+    static float dot(const float* a, const float* b, size_t size);
+
+    // Name of the kernel dot() dispatches to ("avx2-fma" or "scalar")
+    static const char* activeKernel();
+
+    static float dotScalar(const float* a, const float* b, size_t size);
+};
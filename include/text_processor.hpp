@@ -1,6 +1,8 @@
 #pragma once
 
+#include "executor.hpp"
 #include <string>
+#include <string_view>
 #include <vector>
 #include <set>
 #include <unordered_map>
@@ -15,9 +17,24 @@ public:
     // Process text and return vector of tokens
     std::vector<std::string> processText(const std::string& text) const;
     
+    // The same tokens, from pieces of at least `chunkSize` bytes processed
+    // in parallel
+    std::vector<std::string> processText(const std::string& text, Executor& executor,
+                                         size_t chunkSize) const;
+    
     // Get term frequency map for a text
     std::unordered_map<std::string, double> getTermFrequencyMap(const std::string& text) const;
     
+    // Get term frequency map for already processed tokens
+    static std::unordered_map<std::string, double> getTermFrequencyMap(
+        const std::vector<std::string>& tokens);
+    
+    // The same map, counted in parallel. Terms are inserted in the order
+    // they first occur, as the serial count does, so even the map's
+    // iteration order is identical.
+    static std::unordered_map<std::string, double> getTermFrequencyMap(
+        const std::vector<std::string>& tokens, Executor& executor);
+    
     // Set whether to ignore stopwords
     void setIgnoreStopwords(bool ignore) { ignoreStopwords = ignore; }
 
@@ -27,5 +44,6 @@ private:
     
     // Helper functions
     std::string toLowerCase(const std::string& text) const;
-    std::vector<std::string> tokenize(const std::string& text) const;
+    std::vector<std::string> tokenize(std::string_view text) const;
+    void removeStopwords(std::vector<std::string>& tokens) const;
 };
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Keeps the k best-scoring document pairs seen so far in a min-heap. Scores
+// are compared at float32 precision, the precision of binary result files,
+// with ties going to the smaller (doc1, doc2); a single run and a merge of
+// sharded runs therefore select and order exactly the same pairs.
+template <typename T>
+class TopK {
+public:
+    struct Entry {
+        float score;
+        uint32_t doc1;
+        uint32_t doc2;
+        T value;
+    };
+
+    explicit TopK(size_t k) : k(k) {}
+
+    void push(double score, uint32_t doc1, uint32_t doc2, T value) {
+        if (k == 0) return;
+        Entry entry{static_cast<float>(score), doc1, doc2, std::move(value)};
+        if (heap.size() < k) {
+            heap.push_back(std::move(entry));
+            std::push_heap(heap.begin(), heap.end(), better);
+        } else if (better(entry, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), better);
+            heap.back() = std::move(entry);
+            std::push_heap(heap.begin(), heap.end(), better);
+        }
+    }
+
+    // The kept entries, best first; leaves the selector empty
+    std::vector<Entry> take() {
+        std::vector<Entry> entries;
+        entries.swap(heap);
+        std::sort(entries.begin(), entries.end(), better);
+        return entries;
+    }
+
+private:
+    size_t k;
+    std::vector<Entry> heap; // worst kept entry at the front
+
+    static bool better(const Entry& a, const Entry& b) {
+        if (a.score != b.score) return a.score > b.score;
+        if (a.doc1 != b.doc1) return a.doc1 < b.doc1;
+        return a.doc2 < b.doc2;
+    }
+};
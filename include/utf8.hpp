@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// UTF-8 decoding, simple case folding and character classes. Lookups go
+// through two-stage tables (256 shared pages of 256 code points) generated
+// once from the range lists in utf8.cpp; pure-ASCII runs are detected 16
+// bytes at a time and skip decoding entirely.
+class Utf8 {
+public:
+    // Decode the code point at `pos` and advance past it. Invalid or
+    // truncated sequences decode to U+FFFD and consume a single byte.
+    static char32_t decode(std::string_view text, size_t& pos);
+
+    static void encode(char32_t cp, std::string& out);
+
+    // Simple (1:1) Unicode case folding
+    static char32_t foldCase(char32_t cp);
+
+    // Letters, digits and combining marks, i.e. characters inside words
+    static bool isAlphanumeric(char32_t cp);
+    static bool isSpace(char32_t cp);
+    static bool isPunctuation(char32_t cp);
+
+    // Length of the leading run of ASCII bytes
+    static size_t asciiPrefixLength(std::string_view text);
+    static bool isAscii(std::string_view text) {
+        return asciiPrefixLength(text) == text.size();
+    }
+
+    static size_t codepointCount(std::string_view text);
+
+    // Case-fold a whole string
+    static std::string toLowerCase(std::string_view text);
+
+    // Offsets from 0 to text.size() that cut `text` into pieces of at least
+    // `chunkSize` bytes. Each cut follows an ASCII space, tab or line break,
+    // so no word, run of punctuation or UTF-8 sequence spans two pieces.
+    static std::vector<size_t> chunkBoundaries(std::string_view text, size_t chunkSize);
+};
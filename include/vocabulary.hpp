@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+// Concurrent term -> id interning table. Terms are spread over shards by
+// hash; each shard is an open-addressing table that is read without locks,
+// and only inserting a new term takes that shard's mutex. Term bytes live
+// in per-shard append-only arenas.
+//
+// Ids are handed out in arrival order, so they depend on thread timing until
+// finalize() renumbers them in sorted term order.
+class Vocabulary {
+public:
+    using TermId = uint32_t;
+
+    explicit Vocabulary(size_t expectedTerms = 1 << 14);
+    ~Vocabulary();
+
+    Vocabulary(const Vocabulary&) = delete;
+    Vocabulary& operator=(const Vocabulary&) = delete;
+
+    // Id of `term`, adding it if new; safe to call from many threads
+    TermId intern(std::string_view term);
+
+    // Lookup without inserting; lock-free
+    bool find(std::string_view term, TermId& id) const;
+
+    // Bytes of an id returned by intern() or find()
+    std::string_view term(TermId id) const;
+
+    size_t size() const { return nextId.load(std::memory_order_acquire); }
+
+    // Whether terms were added since the last finalize()
+    bool provisional() const { return size() != finalizedSize; }
+
+    // Renumber all ids in lexicographic term order and return the old -> new
+    // mapping. Must not run concurrently with anything else.
+    std::vector<TermId> finalize();
+
+private:
+    struct Entry {
+        const char* data = nullptr;
+        uint32_t length = 0;
+    };
+
+    // Slots hold 0 (empty) or a 32-bit hash tag above id + 1
+    struct Table {
+        explicit Table(size_t capacity);
+        size_t mask;
+        size_t used = 0;
+        std::unique_ptr<std::atomic<uint64_t>[]> slots;
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mutex; // taken only to insert
+        std::atomic<Table*> table{nullptr};
+        std::vector<std::unique_ptr<Table>> tables; // current and outgrown ones
+        std::vector<std::unique_ptr<char[]>> blocks; // term bytes
+        size_t blockUsed = 0;
+        size_t blockSize = 0;
+    };
+
+    static constexpr size_t SHARD_BITS = 6;
+    static constexpr size_t SEGMENTS = 23; // ids in segments of 1024 << k entries
+
+    std::unique_ptr<Shard[]> shards;
+    std::atomic<Entry*> segments[SEGMENTS] = {};
+    std::atomic<TermId> nextId{0};
+    size_t finalizedSize = 0;
+
+    bool findIn(const Table& table, std::string_view term, uint64_t hash, TermId& id) const;
+    void insertSlot(Table& table, uint64_t hash, TermId id);
+    const char* storeBytes(Shard& shard, std::string_view term);
+    Entry& entry(TermId id);
+    const Entry& entry(TermId id) const;
+};
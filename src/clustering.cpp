@@ -0,0 +1,247 @@
+#include "clustering.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+void atomicAdd(std::atomic<double>& target, double value) {
+    double current = target.load(std::memory_order_relaxed);
+    while (!target.compare_exchange_weak(current, current + value, std::memory_order_relaxed)) {
+    }
+}
+
+void atomicMin(std::atomic<double>& target, double value) {
+    double current = target.load(std::memory_order_relaxed);
+    while (value < current &&
+           !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+void atomicMax(std::atomic<double>& target, double value) {
+    double current = target.load(std::memory_order_relaxed);
+    while (value > current &&
+           !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+void appendClusterJson(std::string& out, const Cluster& cluster, size_t index,
+                       const std::vector<std::string>& names, bool withStats) {
+    out += "{\"cluster\":";
+    out += std::to_string(index);
+    out += ",\"size\":";
+    out += std::to_string(cluster.members.size());
+    if (withStats) {
+        out += ",\"representative\":";
+        appendJsonString(out, names[cluster.representative]);
+        out += ",\"pairs\":";
+        out += std::to_string(cluster.pairs);
+        out += ",\"min\":";
+        appendFixed(out, cluster.minScore, 4);
+        out += ",\"mean\":";
+        appendFixed(out, cluster.meanScore, 4);
+        out += ",\"max\":";
+        appendFixed(out, cluster.maxScore, 4);
+    }
+    out += ",\"documents\":[";
+    for (size_t i = 0; i < cluster.members.size(); ++i) {
+        if (i > 0) out += ',';
+        appendJsonString(out, names[cluster.members[i]]);
+    }
+    out += "]}";
+}
+
+} // namespace
+
+ConcurrentUnionFind::ConcurrentUnionFind(size_t size)
+    : count(size), parent(new std::atomic<uint32_t>[size]) {
+    if (size > UINT32_MAX) {
+        throw std::invalid_argument("Too many documents for union-find");
+    }
+    for (size_t i = 0; i < size; ++i) {
+        parent[i].store(static_cast<uint32_t>(i), std::memory_order_relaxed);
+    }
+}
+
+uint32_t ConcurrentUnionFind::find(uint32_t x) {
+    while (true) {
+        uint32_t p = parent[x].load(std::memory_order_acquire);
+        if (p == x) return x;
+        uint32_t grandparent = parent[p].load(std::memory_order_acquire);
+        if (p != grandparent) {
+            // Path halving; losing the race only means less compression
+            parent[x].compare_exchange_weak(p, grandparent, std::memory_order_release,
+                                            std::memory_order_relaxed);
+        }
+        x = grandparent;
+    }
+}
+
+bool ConcurrentUnionFind::unite(uint32_t a, uint32_t b) {
+    while (true) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return false;
+        if (a < b) std::swap(a, b);
+
+        // Link the larger root under the smaller one, if it is still a root
+        uint32_t expected = a;
+        if (parent[a].compare_exchange_strong(expected, b, std::memory_order_acq_rel)) {
+            return true;
+        }
+    }
+}
+
+ClusterBuilder::ClusterBuilder(size_t documents, double threshold)
+    : minScore(threshold), sets(documents), links(new LinkStats[documents]) {}
+
+bool ClusterBuilder::addPair(uint32_t doc1, uint32_t doc2, double score) {
+    if (score < minScore || doc1 == doc2) return false;
+
+    LinkStats& owner = links[doc1];
+    owner.pairs.fetch_add(1, std::memory_order_relaxed);
+    atomicAdd(owner.ownedSum, score);
+    atomicMin(owner.ownedMin, score);
+    atomicMax(owner.ownedMax, score);
+    atomicAdd(links[doc1].totalScore, score);
+    atomicAdd(links[doc2].totalScore, score);
+
+    sets.unite(doc1, doc2);
+    return true;
+}
+
+std::vector<Cluster> ClusterBuilder::clusters() {
+    // Roots are the smallest members, so visiting documents in order creates
+    // clusters already sorted by smallest member
+    std::vector<Cluster> result;
+    std::unordered_map<uint32_t, size_t> clusterOfRoot;
+    std::vector<uint32_t> roots(sets.size());
+    std::vector<uint32_t> sizes(sets.size(), 0);
+    for (size_t i = 0; i < sets.size(); ++i) {
+        roots[i] = sets.find(static_cast<uint32_t>(i));
+        ++sizes[roots[i]];
+    }
+
+    for (size_t i = 0; i < sets.size(); ++i) {
+        uint32_t root = roots[i];
+        if (sizes[root] < 2) continue;
+
+        auto [it, inserted] = clusterOfRoot.emplace(root, result.size());
+        if (inserted) {
+            result.emplace_back();
+            result.back().representative = root;
+            result.back().minScore = 2.0;
+            result.back().maxScore = -1.0;
+            result.back().members.reserve(sizes[root]);
+        }
+        Cluster& cluster = result[it->second];
+        const LinkStats& stats = links[i];
+        cluster.members.push_back(static_cast<uint32_t>(i));
+
+        uint64_t owned = stats.pairs.load();
+        if (owned > 0) {
+            cluster.pairs += owned;
+            cluster.meanScore += stats.ownedSum.load(); // summed here, divided below
+            cluster.minScore = std::min(cluster.minScore, stats.ownedMin.load());
+            cluster.maxScore = std::max(cluster.maxScore, stats.ownedMax.load());
+        }
+        if (stats.totalScore.load() > links[cluster.representative].totalScore.load()) {
+            cluster.representative = static_cast<uint32_t>(i);
+        }
+    }
+
+    for (auto& cluster : result) {
+        cluster.meanScore /= static_cast<double>(cluster.pairs);
+    }
+    return result;
+}
+
+void ClusterWriter::write(const std::vector<Cluster>& clusters, const std::vector<std::string>& names,
+                          ClusterFormat format, const std::string& path, bool withStats) {
+    std::ofstream file;
+    std::ostream* out = &std::cout;
+    if (!path.empty() && path != "-") {
+        file.open(path, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Could not open output file: " + path);
+        }
+        out = &file;
+    }
+
+    std::string buffer;
+    auto flush = [&]() {
+        out->write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    };
+
+    if (format == ClusterFormat::CSV) {
+        buffer += withStats ? "cluster,file,representative,size,pairs,min,mean,max\n" : "cluster,file\n";
+    } else if (format == ClusterFormat::JSON) {
+        buffer += '[';
+    }
+
+    for (size_t index = 0; index < clusters.size(); ++index) {
+        const Cluster& cluster = clusters[index];
+        switch (format) {
+            case ClusterFormat::TEXT:
+                buffer += "Cluster " + std::to_string(index + 1) + " (" +
+                          std::to_string(cluster.members.size()) + " documents";
+                if (withStats) {
+                    buffer += ", " + std::to_string(cluster.pairs) + " pairs, similarity min ";
+                    appendFixed(buffer, cluster.minScore * 100, 1);
+                    buffer += "% / mean ";
+                    appendFixed(buffer, cluster.meanScore * 100, 1);
+                    buffer += "% / max ";
+                    appendFixed(buffer, cluster.maxScore * 100, 1);
+                    buffer += "%";
+                }
+                buffer += ")\n";
+                if (withStats) {
+                    buffer += "  Representative: " + names[cluster.representative] + "\n";
+                }
+                for (uint32_t member : cluster.members) {
+                    buffer += "  " + names[member] + "\n";
+                }
+                buffer += "\n";
+                break;
+            case ClusterFormat::JSON:
+                buffer += index == 0 ? "\n  " : ",\n  ";
+                appendClusterJson(buffer, cluster, index, names, withStats);
+                break;
+            case ClusterFormat::NDJSON:
+                appendClusterJson(buffer, cluster, index, names, withStats);
+                buffer += '\n';
+                break;
+            case ClusterFormat::CSV:
+                for (uint32_t member : cluster.members) {
+                    buffer += std::to_string(index) + ",";
+                    appendCsvField(buffer, names[member]);
+                    if (withStats) {
+                        buffer += ',';
+                        appendCsvField(buffer, names[cluster.representative]);
+                        buffer += "," + std::to_string(cluster.members.size()) + "," +
+                                  std::to_string(cluster.pairs) + ",";
+                        appendFixed(buffer, cluster.minScore, 4);
+                        buffer += ',';
+                        appendFixed(buffer, cluster.meanScore, 4);
+                        buffer += ',';
+                        appendFixed(buffer, cluster.maxScore, 4);
+                    }
+                    buffer += '\n';
+                }
+                break;
+        }
+        if (buffer.size() >= (1 << 20)) flush();
+    }
+
+    if (format == ClusterFormat::JSON) {
+        buffer += clusters.empty() ? "]\n" : "\n]\n";
+    }
+    flush();
+    out->flush();
+    if (!*out) {
+        throw std::runtime_error("Could not write clusters");
+    }
+}
@@ -0,0 +1,461 @@
+#include "corpus.hpp"
+#include "similarity_calculator.hpp"
+#include "shingling.hpp"
+#include "sketch.hpp"
+#include "hashing.hpp"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace {
+
+bool usesCosine(const CompareOptions& options) {
+    return options.algorithm == Algorithm::COSINE || options.algorithm == Algorithm::ALL;
+}
+
+bool usesTfIdf(const CompareOptions& options) {
+    return options.algorithm == Algorithm::TFIDF || options.algorithm == Algorithm::ALL;
+}
+
+bool usesJaccardChar(const CompareOptions& options) {
+    return options.algorithm == Algorithm::JACCARD_CHAR || options.algorithm == Algorithm::ALL;
+}
+
+bool usesJaccardWord(const CompareOptions& options) {
+    return options.algorithm == Algorithm::JACCARD_WORD || options.algorithm == Algorithm::ALL;
+}
+
+// A fixed-size sketch of one document's shingles, filled by a single
+// streaming pass and finalized so comparisons only read it
+template <typename Stream>
+ShingleSketch buildSketch(const CompareOptions& options, Stream&& stream) {
+    ShingleSketch sketch;
+    if (options.sketch == SketchType::HLL) {
+        sketch.hll = HyperLogLogSketch::forError(options.sketchError);
+        stream([&](std::string_view shingle) { sketch.hll->add(hashBytes(shingle.data(), shingle.size())); });
+        return sketch;
+    }
+
+    sketch.minHash = MinHashSketch::forError(options.sketchError);
+    stream([&](std::string_view shingle) { sketch.minHash->add(hashBytes(shingle.data(), shingle.size())); });
+    sketch.minHash->finalize();
+    return sketch;
+}
+
+JaccardEstimate estimateSketchJaccard(const ShingleSketch& sketch1, const ShingleSketch& sketch2) {
+    if (sketch1.hll && sketch2.hll) {
+        return HyperLogLogSketch::estimateJaccard(*sketch1.hll, *sketch2.hll);
+    }
+    return MinHashSketch::estimateJaccard(*sketch1.minHash, *sketch2.minHash);
+}
+
+// Documents larger than this are processed in pieces of this size when
+// buildProfile() is given an executor, and their word shingles in ranges
+// of about as much text
+constexpr size_t CHUNK_SIZE = 1 << 20;
+constexpr size_t CHUNK_TOKENS = 1 << 17;
+
+// compareBatched() hands out documents to threads in tiles, and buffers
+// a wave of documents' results before visiting them in order
+constexpr size_t TILE_DOCUMENTS = 16;
+constexpr size_t WAVE_DOCUMENTS = 2048;
+
+double margin(const JaccardEstimate& estimate) {
+    return std::max(estimate.value - estimate.lower, estimate.upper - estimate.value);
+}
+
+} // namespace
+
+double primaryScore(const SimilarityResult& result, Algorithm algorithm) {
+    switch (algorithm) {
+        case Algorithm::TFIDF: return result.tfidf;
+        case Algorithm::JACCARD_CHAR: return result.jaccardChar;
+        case Algorithm::JACCARD_WORD: return result.jaccardWord;
+        case Algorithm::SIMHASH: return result.simhash;
+        default: return result.cosine;
+    }
+}
+
+Corpus::Corpus(const CompareOptions& options, const TextProcessor& processor,
+               std::pmr::memory_resource* memory)
+    : options(options), processor(processor), profiles(memory),
+      terms(std::make_unique<Vocabulary>()) {}
+
+DocumentProfile Corpus::buildProfile(std::string&& content, Executor* executor) const {
+    return buildProfile(std::move(content), executor, false);
+}
+
+DocumentProfile Corpus::buildProfile(std::string&& content, Executor* executor, bool query) const {
+    DocumentProfile profile;
+    profile.content = std::move(content);
+    Executor* chunks = profile.content.size() > CHUNK_SIZE ? executor : nullptr;
+    if (chunks) {
+        profile.tokens = processor.processText(profile.content, *chunks, CHUNK_SIZE);
+        profile.tf = TextProcessor::getTermFrequencyMap(profile.tokens, *chunks);
+    } else {
+        profile.tokens = processor.processText(profile.content);
+        profile.tf = TextProcessor::getTermFrequencyMap(profile.tokens);
+    }
+
+    if (options.algorithm == Algorithm::SIMHASH) {
+        // The fingerprint is all near-duplicate search needs
+        profile.fingerprint = SimHash::fingerprint(profile.tf);
+        profile.tokens.clear();
+        profile.tf.clear();
+        if (!options.sentences) profile.content.clear();
+        return profile;
+    }
+
+    if (usesCosine(options) && !options.exact) {
+        if (options.hashDims > 0) {
+            profile.hashedVector = HashedVector::fromTermFrequencies(profile.tf, options.hashDims);
+        } else {
+            profile.termVector = query
+                ? TermVector::fromKnownTermFrequencies(profile.tf, *terms)
+                : TermVector::fromTermFrequencies(profile.tf, *terms);
+        }
+    }
+    if (usesJaccardChar(options) && options.sketch == SketchType::NONE) {
+        profile.charShingles = chunks
+            ? ShinglingCalculator::generatePackedCharacterShingles(profile.content, options.shingleSize,
+                                                                   *chunks, CHUNK_SIZE)
+            : ShinglingCalculator::generatePackedCharacterShingles(profile.content, options.shingleSize);
+    }
+    if (chunks && usesJaccardWord(options) && options.sketch == SketchType::NONE) {
+        profile.wordShingles = ShinglingCalculator::generateSortedWordShingles(
+            profile.tokens, options.shingleSize, *chunks, CHUNK_TOKENS);
+    }
+    if (options.analysis) {
+        profile.stats = chunks
+            ? DocumentAnalyzer::analyzeDocument(profile.content, profile.tokens, *chunks, CHUNK_SIZE)
+            : DocumentAnalyzer::analyzeDocument(profile.content, profile.tokens);
+    }
+
+    if (options.sketch != SketchType::NONE) {
+        if (usesJaccardChar(options)) {
+            profile.charSketch = buildSketch(options, [&](auto&& visit) {
+                ShinglingCalculator::forEachCharacterShingle(profile.content, options.shingleSize, visit);
+            });
+        }
+        if (usesJaccardWord(options)) {
+            profile.wordSketch = buildSketch(options, [&](auto&& visit) {
+                ShinglingCalculator::forEachWordShingle(profile.tokens, options.shingleSize, visit);
+            });
+        }
+        // The sketches replace the shingle sources; keep only what other scores read
+        profile.tokens = std::vector<std::string>();
+        if (!options.sentences) profile.content = std::string();
+        if (!usesTfIdf(options) && !(usesCosine(options) && options.exact)) {
+            profile.tf = std::unordered_map<std::string, double>();
+        }
+    }
+    return profile;
+}
+
+Corpus::DocumentId Corpus::add(std::string_view content) {
+    return add(buildProfile(std::string(content)));
+}
+
+Corpus::DocumentId Corpus::add(DocumentProfile&& profile) {
+    if (profiles.size() >= UINT32_MAX) {
+        throw std::runtime_error("Corpus is full");
+    }
+    profiles.push_back(std::move(profile));
+    idfStale = true;
+    return static_cast<DocumentId>(profiles.size() - 1);
+}
+
+void Corpus::finalize() {
+    idfStale = false;
+    if (terms->provisional()) {
+        std::vector<Vocabulary::TermId> renumbered = terms->finalize();
+        for (auto& profile : profiles) {
+            profile.termVector.renumber(renumbered);
+            profile.tfidfVector.renumber(renumbered);
+        }
+    }
+    if (!options.corpusIdf || !usesTfIdf(options)) return;
+
+    std::vector<const std::unordered_map<std::string, double>*> documents;
+    documents.reserve(profiles.size());
+    for (const auto& profile : profiles) documents.push_back(&profile.tf);
+    idf = SimilarityCalculator::calculateIdf(documents);
+
+    if (!options.exact) {
+        for (auto& profile : profiles) {
+            profile.tfidfVector = TermVector::fromTfIdf(profile.tf, idf, *terms);
+        }
+    }
+    if (options.searchIndex && !options.exact) {
+        std::vector<const TermVector*> vectors;
+        vectors.reserve(profiles.size());
+        for (const auto& profile : profiles) vectors.push_back(&profile.tfidfVector);
+        index = std::make_unique<InvertedIndex>(vectors);
+    }
+}
+
+void Corpus::checkFinalized() const {
+    if (idfStale && options.corpusIdf && usesTfIdf(options)) {
+        throw std::logic_error("Corpus::finalize() must be called after adding documents");
+    }
+}
+
+SimilarityResult Corpus::compare(DocumentId doc1, DocumentId doc2) const {
+    return compare(profiles.at(doc1), profiles.at(doc2));
+}
+
+SimilarityResult Corpus::compare(const DocumentProfile& doc1, const DocumentProfile& doc2) const {
+    checkFinalized();
+    auto start = std::chrono::high_resolution_clock::now();
+
+    SimilarityResult result;
+
+    const std::string& content1 = doc1.content;
+    const std::string& content2 = doc2.content;
+    const auto& tf1 = doc1.tf;
+    const auto& tf2 = doc2.tf;
+
+    if (options.algorithm == Algorithm::SIMHASH) {
+        result.hammingDistance = SimHash::hammingDistance(doc1.fingerprint, doc2.fingerprint);
+        result.simhash = SimHash::similarity(doc1.fingerprint, doc2.fingerprint);
+    }
+
+    // Cascade bounds: a score not computed yet is at most 1, or for exact
+    // character Jaccard at most the ratio of the two set sizes; disabled
+    // scores stay 0 as in the confidence calculation
+    double cosineBound = usesCosine(options) ? 1.0 : 0.0;
+    double tfidfBound = usesTfIdf(options) ? 1.0 : 0.0;
+    double charBound = usesJaccardChar(options) ? 1.0 : 0.0;
+    double wordBound = usesJaccardWord(options) ? 1.0 : 0.0;
+    if (usesJaccardChar(options) && options.sketch == SketchType::NONE) {
+        size_t smaller = std::min(doc1.charShingles.size(), doc2.charShingles.size());
+        size_t larger = std::max(doc1.charShingles.size(), doc2.charShingles.size());
+        charBound = larger ? static_cast<double>(smaller) / larger : 0.0;
+    }
+    bool computedAny = false;
+
+    // The first stage always runs; later ones only while the pair can still matter
+    auto shouldRun = [&](unsigned stage) {
+        if (options.cascade < 0.0 || !computedAny) {
+            computedAny = true;
+            return true;
+        }
+        double combined = DocumentAnalyzer::combinedScore(cosineBound, tfidfBound, charBound, wordBound);
+        double primaryBound = options.algorithm == Algorithm::TFIDF ? tfidfBound
+                            : options.algorithm == Algorithm::JACCARD_CHAR ? charBound
+                            : options.algorithm == Algorithm::JACCARD_WORD ? wordBound
+                            : cosineBound;
+        bool primaryReachable = options.primaryThreshold <= 0.0 || primaryBound >= options.primaryThreshold;
+        if (combined >= options.cascade && primaryReachable) {
+            return true;
+        }
+        result.skipped |= stage;
+        return false;
+    };
+
+    // Cosine similarity
+    if (usesCosine(options) && shouldRun(STAGE_COSINE)) {
+        if (options.exact) {
+            result.cosine = SimilarityCalculator::calculateCosineSimilarity(tf1, tf2);
+        } else if (options.hashDims > 0) {
+            result.cosine = SimilarityCalculator::calculateCosineSimilarity(
+                doc1.hashedVector, doc2.hashedVector);
+        } else {
+            result.cosine = SimilarityCalculator::calculateCosineSimilarity(
+                doc1.termVector, doc2.termVector);
+        }
+        cosineBound = result.cosine;
+    }
+
+    // Character Jaccard
+    if (usesJaccardChar(options) && shouldRun(STAGE_JACCARD_CHAR)) {
+        if (options.sketch != SketchType::NONE) {
+            auto estimate = estimateSketchJaccard(doc1.charSketch, doc2.charSketch);
+            result.jaccardChar = estimate.value;
+            result.jaccardCharMargin = margin(estimate);
+            charBound = estimate.upper;
+        } else {
+            result.jaccardChar = ShinglingCalculator::calculateJaccardSimilarity(
+                doc1.charShingles, doc2.charShingles);
+            charBound = result.jaccardChar;
+        }
+    }
+
+    // TF-IDF similarity
+    if (usesTfIdf(options) && shouldRun(STAGE_TFIDF)) {
+        if (options.corpusIdf && options.exact) {
+            result.tfidf = SimilarityCalculator::calculateTfIdfCosineSimilarity(tf1, tf2, idf);
+        } else if (options.corpusIdf) {
+            result.tfidf = SimilarityCalculator::calculateCosineSimilarity(
+                doc1.tfidfVector, doc2.tfidfVector);
+        } else {
+            std::vector<std::unordered_map<std::string, double>> docs = {tf1, tf2};
+            auto pairIdf = SimilarityCalculator::calculateIdf(docs);
+            result.tfidf = SimilarityCalculator::calculateTfIdfCosineSimilarity(tf1, tf2, pairIdf);
+        }
+        tfidfBound = result.tfidf;
+    }
+
+    // Word Jaccard, the most expensive score
+    if (usesJaccardWord(options) && shouldRun(STAGE_JACCARD_WORD)) {
+        if (options.sketch != SketchType::NONE) {
+            auto estimate = estimateSketchJaccard(doc1.wordSketch, doc2.wordSketch);
+            result.jaccardWord = estimate.value;
+            result.jaccardWordMargin = margin(estimate);
+            wordBound = estimate.upper;
+        } else {
+            const auto& tokens1 = doc1.tokens;
+            const auto& tokens2 = doc2.tokens;
+            // Shingles built ahead are never empty
+            std::vector<std::string> built1, built2;
+            if (doc1.wordShingles.empty()) {
+                built1 = ShinglingCalculator::generateSortedWordShingles(tokens1, options.shingleSize);
+            }
+            if (doc2.wordShingles.empty()) {
+                built2 = ShinglingCalculator::generateSortedWordShingles(tokens2, options.shingleSize);
+            }
+            result.jaccardWord = ShinglingCalculator::calculateJaccardSimilarity(
+                doc1.wordShingles.empty() ? built1 : doc1.wordShingles,
+                doc2.wordShingles.empty() ? built2 : doc2.wordShingles);
+            wordBound = result.jaccardWord;
+        }
+    }
+
+    // Document analysis; statistics are precomputed, so this is never skipped
+    if (options.analysis) {
+        result.stats1 = doc1.stats;
+        result.stats2 = doc2.stats;
+        result.confidence = DocumentAnalyzer::analyzeSimilarityConfidence(
+            result.cosine, result.tfidf, result.jaccardChar, result.jaccardWord);
+    }
+
+    // Sentence-level analysis
+    if (options.sentences && shouldRun(STAGE_SENTENCES)) {
+        result.sentenceSimilarities = DocumentAnalyzer::analyzeSentenceSimilarity(content1, content2);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    result.duration = std::chrono::duration<double, std::milli>(end - start).count();
+
+    return result;
+}
+
+std::vector<Corpus::Comparison> Corpus::compare(const std::vector<DocumentId>& ids1,
+                                                const std::vector<DocumentId>& ids2,
+                                                Executor* executor) const {
+    checkFinalized();
+
+    std::vector<Comparison> comparisons;
+    for (DocumentId doc1 : ids1) {
+        for (DocumentId doc2 : ids2) {
+            if (doc1 != doc2) comparisons.push_back({doc1, doc2, SimilarityResult()});
+        }
+    }
+
+    auto task = [&](size_t i) {
+        comparisons[i].result = compare(comparisons[i].doc1, comparisons[i].doc2);
+    };
+    if (executor) {
+        executor->parallelFor(comparisons.size(), task);
+    } else {
+        for (size_t i = 0; i < comparisons.size(); ++i) task(i);
+    }
+    return comparisons;
+}
+
+void Corpus::compareBatched(const std::vector<DocumentId>& queries,
+                            const std::vector<DocumentId>& documents, size_t batchSize,
+                            const std::function<void(const Comparison&)>& visit,
+                            Executor* executor) const {
+    checkFinalized();
+    batchSize = std::max<size_t>(batchSize, 1);
+
+    std::vector<Comparison> pending;
+    for (size_t batch = 0; batch < queries.size(); batch += batchSize) {
+        const size_t batchEnd = std::min(queries.size(), batch + batchSize);
+        const size_t width = batchEnd - batch;
+        for (size_t wave = 0; wave < documents.size(); wave += WAVE_DOCUMENTS) {
+            const size_t waveEnd = std::min(documents.size(), wave + WAVE_DOCUMENTS);
+            pending.assign((waveEnd - wave) * width, Comparison());
+
+            auto task = [&](size_t tile) {
+                size_t tileEnd = std::min(waveEnd, wave + (tile + 1) * TILE_DOCUMENTS);
+                for (size_t d = wave + tile * TILE_DOCUMENTS; d < tileEnd; ++d) {
+                    for (size_t q = batch; q < batchEnd; ++q) {
+                        Comparison& slot = pending[(d - wave) * width + (q - batch)];
+                        slot.doc1 = queries[q];
+                        slot.doc2 = documents[d];
+                        if (slot.doc1 != slot.doc2) slot.result = compare(slot.doc1, slot.doc2);
+                    }
+                }
+            };
+            size_t tiles = (waveEnd - wave + TILE_DOCUMENTS - 1) / TILE_DOCUMENTS;
+            if (executor) {
+                executor->parallelFor(tiles, task);
+            } else {
+                for (size_t tile = 0; tile < tiles; ++tile) task(tile);
+            }
+
+            for (const auto& comparison : pending) {
+                if (comparison.doc1 != comparison.doc2) visit(comparison);
+            }
+        }
+    }
+}
+
+std::vector<Corpus::Match> Corpus::topK(std::string_view query, size_t k, Executor* executor) const {
+    checkFinalized();
+
+    DocumentProfile queryProfile = buildProfile(std::string(query), nullptr, true);
+    if (options.corpusIdf && usesTfIdf(options) && !options.exact) {
+        queryProfile.tfidfVector = TermVector::fromKnownTfIdf(queryProfile.tf, idf, *terms);
+    }
+
+    std::vector<Match> matches(profiles.size());
+    auto task = [&](size_t i) {
+        matches[i].document = static_cast<DocumentId>(i);
+        matches[i].result = compare(queryProfile, profiles[i]);
+        matches[i].score = primaryScore(matches[i].result, options.algorithm);
+    };
+    if (executor) {
+        executor->parallelFor(profiles.size(), task);
+    } else {
+        for (size_t i = 0; i < profiles.size(); ++i) task(i);
+    }
+
+    auto better = [](const Match& a, const Match& b) {
+        return a.score != b.score ? a.score > b.score : a.document < b.document;
+    };
+    k = std::min(k, matches.size());
+    std::partial_sort(matches.begin(), matches.begin() + k, matches.end(), better);
+    matches.resize(k);
+    return matches;
+}
+
+std::vector<Corpus::Match> Corpus::search(std::string_view query, size_t k, SearchStats* stats) const {
+    checkFinalized();
+    if (!index) {
+        throw std::logic_error("Corpus::search() needs searchIndex and corpusIdf with TF-IDF");
+    }
+
+    std::unordered_map<std::string, double> tf =
+        TextProcessor::getTermFrequencyMap(processor.processText(std::string(query)));
+    TermVector vector = TermVector::fromKnownTfIdf(tf, idf, *terms);
+
+    std::vector<Match> matches;
+    for (const auto& hit : index->search(vector, k, stats)) {
+        Match match;
+        match.document = hit.document;
+        match.score = hit.score;
+        match.result.tfidf = hit.score;
+        matches.push_back(std::move(match));
+    }
+    return matches;
+}
+
+std::vector<NearDuplicate> Corpus::nearDuplicates(int maxDistance) const {
+    std::vector<uint64_t> fingerprints;
+    fingerprints.reserve(profiles.size());
+    for (const auto& profile : profiles) fingerprints.push_back(profile.fingerprint);
+    return SimHash::findNearDuplicates(fingerprints, maxDistance);
+}
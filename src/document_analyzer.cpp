@@ -1,11 +1,42 @@
 #include "document_analyzer.hpp"
 #include "text_processor.hpp"
 #include "similarity_calculator.hpp"
+#include "utf8.hpp"
 #include <algorithm>
+#include <cctype>
 #include <sstream>
-#include <regex>
+#include <functional>
+#include <string_view>
+#include <unordered_set>
 #include <iomanip>
 
+namespace {
+
+// Tokens deduplicated per task, and hash partitions they are then counted in
+constexpr size_t UNIQUE_RANGE = 1 << 16;
+constexpr size_t UNIQUE_PARTITIONS = 64;
+
+// Maximal runs of . ! and ?, i.e. the matches of the pattern [.!?]+
+size_t countTerminatorRuns(std::string_view text) {
+    size_t runs = 0;
+    bool inRun = false;
+    for (char c : text) {
+        bool terminator = c == '.' || c == '!' || c == '?';
+        if (terminator && !inRun) ++runs;
+        inRun = terminator;
+    }
+    return runs;
+}
+
+void deriveMetrics(DocumentStats& stats) {
+    if (stats.sentenceCount == 0) stats.sentenceCount = 1; // At least one sentence
+    stats.averageWordsPerSentence = static_cast<double>(stats.wordCount) / stats.sentenceCount;
+    stats.lexicalDiversity = stats.wordCount > 0 ? 
+        static_cast<double>(stats.uniqueWords) / stats.wordCount : 0.0;
+}
+
+} // namespace
+
 DocumentStats DocumentAnalyzer::analyzeDocument(const std::string& content, 
                                                const std::vector<std::string>& tokens) {
     DocumentStats stats;
@@ -14,32 +45,71 @@ DocumentStats DocumentAnalyzer::analyzeDocument(const std::string& content,
     stats.characterCount = content.length();
     
     // Count sentences (rough estimate using punctuation)
-    std::regex sentenceRegex(R"([.!?]+)");
-    std::sregex_iterator iter(content.begin(), content.end(), sentenceRegex);
-    std::sregex_iterator end;
-    stats.sentenceCount = std::distance(iter, end);
-    if (stats.sentenceCount == 0) stats.sentenceCount = 1; // At least one sentence
+    stats.sentenceCount = countTerminatorRuns(content);
     
     // Count unique words
     std::set<std::string> uniqueTokens(tokens.begin(), tokens.end());
     stats.uniqueWords = uniqueTokens.size();
     
-    // Calculate derived metrics
-    stats.averageWordsPerSentence = static_cast<double>(stats.wordCount) / stats.sentenceCount;
-    stats.lexicalDiversity = stats.wordCount > 0 ? 
-        static_cast<double>(stats.uniqueWords) / stats.wordCount : 0.0;
+    deriveMetrics(stats);
+    return stats;
+}
+
+DocumentStats DocumentAnalyzer::analyzeDocument(const std::string& content,
+                                               const std::vector<std::string>& tokens,
+                                               Executor& executor, size_t chunkSize) {
+    DocumentStats stats;
+    stats.wordCount = tokens.size();
+    stats.characterCount = content.length();
+    
+    // Cuts follow whitespace, so no run of terminators spans two pieces
+    std::string_view view(content);
+    std::vector<size_t> bounds = Utf8::chunkBoundaries(view, chunkSize);
+    std::vector<size_t> runs(bounds.size() - 1);
+    executor.parallelFor(runs.size(), [&](size_t i) {
+        runs[i] = countTerminatorRuns(view.substr(bounds[i], bounds[i + 1] - bounds[i]));
+    });
+    for (size_t count : runs) stats.sentenceCount += count;
+    
+    // Distinct tokens of each range go to hash partitions, and each
+    // partition is deduplicated across ranges
+    std::vector<std::vector<std::vector<std::string_view>>> distinct(
+        (tokens.size() + UNIQUE_RANGE - 1) / UNIQUE_RANGE);
+    executor.parallelFor(distinct.size(), [&](size_t r) {
+        distinct[r].resize(UNIQUE_PARTITIONS);
+        std::unordered_set<std::string_view> seen;
+        size_t end = std::min(tokens.size(), (r + 1) * UNIQUE_RANGE);
+        for (size_t i = r * UNIQUE_RANGE; i < end; ++i) {
+            std::string_view token(tokens[i]);
+            if (seen.insert(token).second) {
+                distinct[r][std::hash<std::string_view>()(token) % UNIQUE_PARTITIONS].push_back(token);
+            }
+        }
+    });
+    std::vector<size_t> unique(UNIQUE_PARTITIONS);
+    executor.parallelFor(UNIQUE_PARTITIONS, [&](size_t p) {
+        std::unordered_set<std::string_view> seen;
+        for (const auto& range : distinct) seen.insert(range[p].begin(), range[p].end());
+        unique[p] = seen.size();
+    });
+    for (size_t count : unique) stats.uniqueWords += count;
     
+    deriveMetrics(stats);
     return stats;
 }
 
+double DocumentAnalyzer::combinedScore(
+    double cosine, double tfidf, double jaccardChar, double jaccardWord) {
+    return (cosine * 0.4) + (jaccardChar * 0.3) + (jaccardWord * 0.2) + (tfidf * 0.1);
+}
+
 SimilarityConfidence DocumentAnalyzer::analyzeSimilarityConfidence(
     double cosine, double tfidf, double jaccardChar, double jaccardWord) {
     
     SimilarityConfidence confidence;
     
     // Calculate weighted average (cosine and jaccard are most reliable)
-    double weightedScore = (cosine * 0.4) + (jaccardChar * 0.3) + 
-                          (jaccardWord * 0.2) + (tfidf * 0.1);
+    double weightedScore = combinedScore(cosine, tfidf, jaccardChar, jaccardWord);
     confidence.score = weightedScore;
     
     // Determine confidence level and interpretation
@@ -180,26 +250,41 @@ std::string DocumentAnalyzer::generateAnalysisSummary(
     return summary.str();
 }
 
-std::vector<std::string> DocumentAnalyzer::splitIntoSentences(const std::string& text) {
-    std::vector<std::string> sentences;
-    std::regex sentenceRegex(R"([.!?]+\s*)");
-    std::sregex_token_iterator iter(text.begin(), text.end(), sentenceRegex, -1);
-    std::sregex_token_iterator end;
+std::vector<std::pair<size_t, size_t>> DocumentAnalyzer::findSentences(const std::string& text) {
+    std::vector<std::pair<size_t, size_t>> sentences;
+    auto isTerminator = [](char c) { return c == '.' || c == '!' || c == '?'; };
+    auto isTrimmed = [](char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; };
     
-    for (; iter != end; ++iter) {
-        std::string sentence = iter->str();
-        // Trim whitespace
-        sentence.erase(0, sentence.find_first_not_of(" \t\n\r"));
-        sentence.erase(sentence.find_last_not_of(" \t\n\r") + 1);
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = start;
+        while (end < text.size() && !isTerminator(text[end])) ++end;
         
-        if (!sentence.empty() && sentence.length() > 5) {
-            sentences.push_back(sentence);
+        // Trim whitespace
+        size_t first = start, last = end;
+        while (first < last && isTrimmed(text[first])) ++first;
+        while (last > first && isTrimmed(text[last - 1])) --last;
+        if (last - first > 5) {
+            sentences.emplace_back(first, last - first);
         }
+        
+        // The separator is the punctuation run and any whitespace after it
+        while (end < text.size() && isTerminator(text[end])) ++end;
+        while (end < text.size() && std::isspace(static_cast<unsigned char>(text[end]))) ++end;
+        start = end;
     }
     
     return sentences;
 }
 
+std::vector<std::string> DocumentAnalyzer::splitIntoSentences(const std::string& text) {
+    std::vector<std::string> sentences;
+    for (const auto& [offset, length] : findSentences(text)) {
+        sentences.push_back(text.substr(offset, length));
+    }
+    return sentences;
+}
+
 std::vector<std::string> DocumentAnalyzer::getTopWords(
     const std::unordered_map<std::string, double>& termFreq, size_t count) {
     
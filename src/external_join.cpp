@@ -0,0 +1,340 @@
+#include "external_join.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <queue>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Runs with more files than this are merged in several passes
+constexpr size_t MAX_FAN_IN = 64;
+
+FILE* openFile(const std::string& path, const char* mode) {
+    FILE* file = std::fopen(path.c_str(), mode);
+    if (!file) {
+        throw std::runtime_error("Could not open spill file: " + path);
+    }
+    return file;
+}
+
+template <typename T>
+class RunWriter {
+public:
+    RunWriter(const std::string& path, size_t bufferRecords)
+        : file(openFile(path, "wb")), capacity(std::max<size_t>(1, bufferRecords)) {
+        buffer.reserve(capacity);
+    }
+    ~RunWriter() {
+        if (file) std::fclose(file);
+    }
+
+    // Adjacent records with the same key are combined before writing
+    void push(const T& record) {
+        if (hasPending && pending.absorb(record)) return;
+        if (hasPending) {
+            buffer.push_back(pending);
+            if (buffer.size() == capacity) flush();
+        }
+        pending = record;
+        hasPending = true;
+    }
+
+    void close() {
+        if (hasPending) buffer.push_back(pending);
+        hasPending = false;
+        flush();
+        if (std::fclose(file) != 0) {
+            file = nullptr;
+            throw std::runtime_error("Could not write spill file");
+        }
+        file = nullptr;
+    }
+
+private:
+    FILE* file;
+    size_t capacity;
+    std::vector<T> buffer;
+    T pending{};
+    bool hasPending = false;
+
+    void flush() {
+        if (!buffer.empty() &&
+            std::fwrite(buffer.data(), sizeof(T), buffer.size(), file) != buffer.size()) {
+            throw std::runtime_error("Could not write spill file");
+        }
+        buffer.clear();
+    }
+};
+
+template <typename T>
+class RunReader {
+public:
+    RunReader(const std::string& path, size_t bufferRecords)
+        : file(openFile(path, "rb")), buffer(std::max<size_t>(1, bufferRecords)) {}
+    RunReader(RunReader&& other) noexcept
+        : file(other.file), buffer(std::move(other.buffer)), position(other.position), count(other.count) {
+        other.file = nullptr;
+    }
+    ~RunReader() {
+        if (file) std::fclose(file);
+    }
+
+    bool next(T& record) {
+        if (position == count) {
+            count = std::fread(buffer.data(), sizeof(T), buffer.size(), file);
+            position = 0;
+            if (count == 0) return false;
+        }
+        record = buffer[position++];
+        return true;
+    }
+
+private:
+    FILE* file;
+    std::vector<T> buffer;
+    size_t position = 0;
+    size_t count = 0;
+};
+
+// Sort a buffer and write it as one run, combining equal keys
+template <typename T>
+void writeSortedRun(std::vector<T>& records, const std::string& path) {
+    std::sort(records.begin(), records.end());
+    RunWriter<T> writer(path, 1 << 16);
+    for (const auto& record : records) writer.push(record);
+    writer.close();
+}
+
+// Stream the k-way merge of sorted runs into `visit`, in sorted order
+template <typename T, typename Visit>
+void mergeRuns(const std::vector<std::string>& runs, size_t bufferBytes, Visit&& visit) {
+    size_t bufferRecords = bufferBytes / sizeof(T) / std::max<size_t>(1, runs.size());
+    std::vector<RunReader<T>> readers;
+    readers.reserve(runs.size());
+    for (const auto& path : runs) readers.emplace_back(path, std::max<size_t>(bufferRecords, 1024));
+
+    using Head = std::pair<T, size_t>;
+    auto later = [](const Head& a, const Head& b) { return b.first < a.first; };
+    std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+    for (size_t i = 0; i < readers.size(); ++i) {
+        T record;
+        if (readers[i].next(record)) heads.emplace(record, i);
+    }
+
+    while (!heads.empty()) {
+        Head head = heads.top();
+        heads.pop();
+        visit(head.first);
+        T record;
+        if (readers[head.second].next(record)) heads.emplace(record, head.second);
+    }
+}
+
+// Merge groups of runs until at most MAX_FAN_IN remain
+template <typename T, typename NextPath>
+std::vector<std::string> reduceRuns(std::vector<std::string> runs, size_t bufferBytes,
+                                    NextPath&& nextPath) {
+    while (runs.size() > MAX_FAN_IN) {
+        std::vector<std::string> merged;
+        for (size_t first = 0; first < runs.size(); first += MAX_FAN_IN) {
+            std::vector<std::string> group(runs.begin() + first,
+                                           runs.begin() + std::min(runs.size(), first + MAX_FAN_IN));
+            if (group.size() == 1) {
+                merged.push_back(group.front());
+                continue;
+            }
+            std::string path = nextPath();
+            RunWriter<T> writer(path, bufferBytes / 2 / sizeof(T));
+            mergeRuns<T>(group, bufferBytes / 2, [&](const T& record) { writer.push(record); });
+            writer.close();
+            for (const auto& done : group) fs::remove(done);
+            merged.push_back(path);
+        }
+        runs.swap(merged);
+    }
+    return runs;
+}
+
+} // namespace
+
+ProgressMeter::ProgressMeter(const char* phase, uint64_t total, bool enabled)
+    : phase(phase), total(total), enabled(enabled),
+      start(std::chrono::steady_clock::now()), lastPrint(start) {}
+
+void ProgressMeter::update(uint64_t done, bool final) {
+    if (!enabled) return;
+    auto now = std::chrono::steady_clock::now();
+    if (!final && now - lastPrint < std::chrono::milliseconds(500)) return;
+    lastPrint = now;
+
+    double elapsed = std::chrono::duration<double>(now - start).count();
+    double fraction = total ? std::min(1.0, static_cast<double>(done) / total) : 1.0;
+    std::fprintf(stderr, "\r%s: %llu/%llu (%.1f%%)", phase,
+                 static_cast<unsigned long long>(done),
+                 static_cast<unsigned long long>(total), fraction * 100);
+    if (!final && fraction > 0.0) {
+        std::fprintf(stderr, " ETA %.0fs   ", elapsed / fraction - elapsed);
+    } else {
+        std::fprintf(stderr, " %.1fs      ", elapsed);
+    }
+    if (final) std::fputc('\n', stderr);
+    std::fflush(stderr);
+}
+
+ExternalJaccard::ExternalJaccard(size_t documentCount, const ExternalOptions& options)
+    : options(options), sizes(documentCount, 0),
+      addProgress("Spilling shingles", documentCount, options.showProgress) {
+    if (documentCount > UINT32_MAX) {
+        throw std::invalid_argument("Too many documents for external mode");
+    }
+    if (this->options.maxMemory < (size_t(1) << 20)) {
+        throw std::invalid_argument("--max-memory must be at least 1 MiB");
+    }
+
+    fs::path base = options.tempDir.empty() ? fs::temp_directory_path() : fs::path(options.tempDir);
+    std::string pattern = (base / "simtext-XXXXXX").string();
+    if (!mkdtemp(&pattern[0])) {
+        throw std::runtime_error("Could not create spill directory in " + base.string());
+    }
+    directory = pattern;
+}
+
+ExternalJaccard::~ExternalJaccard() {
+    std::error_code error;
+    fs::remove_all(directory, error);
+}
+
+std::string ExternalJaccard::nextRunPath(const char* kind) {
+    return (fs::path(directory) / (kind + std::to_string(runCounter++))).string();
+}
+
+void ExternalJaccard::spillPostings(std::vector<Posting>& buffer) {
+    if (buffer.empty()) return;
+    std::string path = nextRunPath("postings-");
+    writeSortedRun(buffer, path);
+    postingRuns.push_back(path);
+    buffer.clear();
+    buffer.shrink_to_fit();
+}
+
+void ExternalJaccard::addDocument(uint32_t doc, const std::vector<uint64_t>& shingles) {
+    // Two posting buffers at most (one filling, one being spilled), each of
+    // which can have grown to twice its limit
+    const size_t limit = options.maxMemory / 4 / sizeof(Posting);
+
+    std::unique_lock<std::mutex> lock(bufferMutex);
+    sizes.at(doc) = static_cast<uint32_t>(shingles.size());
+    for (uint64_t shingle : shingles) {
+        postings.push_back({shingle, doc, 0});
+    }
+    totalPostings += shingles.size();
+    addProgress.update(++documentsAdded);
+
+    if (postings.size() < limit) return;
+
+    std::vector<Posting> full;
+    std::lock_guard<std::mutex> spillLock(spillMutex);
+    full.swap(postings);
+    lock.unlock();
+    spillPostings(full);
+}
+
+std::vector<std::string> ExternalJaccard::generatePairRuns(uint64_t& pairRecords) {
+    const size_t readerBytes = options.maxMemory / 4;
+    const size_t pairLimit = options.maxMemory / 4 / sizeof(uint64_t);
+
+    auto runs = reduceRuns<Posting>(postingRuns, readerBytes, [&]() { return nextRunPath("postings-"); });
+    postingRuns.clear();
+
+    std::vector<std::string> pairRuns;
+    std::vector<uint64_t> pairs;
+    std::vector<uint32_t> group;
+    uint64_t groupShingle = 0;
+    uint64_t merged = 0;
+    ProgressMeter progress("Counting overlaps", totalPostings, options.showProgress);
+
+    auto flushPairs = [&]() {
+        if (pairs.empty()) return;
+        std::sort(pairs.begin(), pairs.end());
+        std::string path = nextRunPath("pairs-");
+        RunWriter<PairCount> writer(path, 1 << 16);
+        for (uint64_t pair : pairs) writer.push({pair, 1});
+        writer.close();
+        pairRuns.push_back(path);
+        pairs.clear();
+    };
+
+    // Documents in a group are sorted, so every emitted pair has doc1 < doc2.
+    // An over-frequent shingle emits nothing and leaves the sets it was in.
+    auto closeGroup = [&]() {
+        if (options.maxDocumentFrequency > 0 && group.size() > options.maxDocumentFrequency) {
+            for (uint32_t doc : group) --sizes[doc];
+            group.clear();
+            return;
+        }
+        for (size_t i = 0; i < group.size(); ++i) {
+            for (size_t j = i + 1; j < group.size(); ++j) {
+                pairs.push_back(static_cast<uint64_t>(group[i]) << 32 | group[j]);
+                if (pairs.size() >= pairLimit) flushPairs();
+            }
+        }
+        group.clear();
+    };
+
+    mergeRuns<Posting>(runs, readerBytes, [&](const Posting& posting) {
+        if (!group.empty() && posting.shingle != groupShingle) closeGroup();
+        groupShingle = posting.shingle;
+        group.push_back(posting.doc);
+        if ((++merged & 0xFFFF) == 0) progress.update(merged);
+    });
+    closeGroup();
+    flushPairs();
+    progress.update(merged, true);
+
+    for (const auto& path : runs) fs::remove(path);
+
+    auto reduced = reduceRuns<PairCount>(pairRuns, readerBytes, [&]() { return nextRunPath("pairs-"); });
+    pairRecords = 0;
+    for (const auto& path : reduced) {
+        pairRecords += fs::file_size(path) / sizeof(PairCount);
+    }
+    return reduced;
+}
+
+void ExternalJaccard::run(const Visitor& visit) {
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        addProgress.update(documentsAdded, true);
+        spillPostings(postings);
+    }
+
+    uint64_t pairRecords = 0;
+    auto pairRuns = generatePairRuns(pairRecords);
+
+    // Equal pairs arrive adjacent from the merge; sum them, then score
+    ProgressMeter progress("Scoring pairs", pairRecords, options.showProgress);
+    uint64_t merged = 0;
+    PairCount pending{0, 0};
+    auto report = [&](const PairCount& total) {
+        uint32_t doc1 = static_cast<uint32_t>(total.pair >> 32);
+        uint32_t doc2 = static_cast<uint32_t>(total.pair);
+        double unionSize = static_cast<double>(sizes[doc1]) + sizes[doc2] - total.count;
+        visit(doc1, doc2, static_cast<double>(total.count) / unionSize);
+    };
+    mergeRuns<PairCount>(pairRuns, options.maxMemory / 4, [&](const PairCount& record) {
+        if (!pending.absorb(record)) {
+            if (pending.count) report(pending);
+            pending = record;
+        }
+        if ((++merged & 0xFFFF) == 0) progress.update(merged);
+    });
+    if (pending.count) report(pending);
+    progress.update(merged, true);
+
+    for (const auto& path : pairRuns) fs::remove(path);
+}
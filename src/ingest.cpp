@@ -0,0 +1,177 @@
+#include "ingest.hpp"
+#include "bounded_queue.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct PendingDocument {
+    size_t index = 0;
+    std::string content;
+};
+
+void appendListFile(const std::string& listFile, std::vector<std::string>& files) {
+    std::ifstream file;
+    std::istream* in = &std::cin;
+    if (listFile != "-") {
+        file.open(listFile);
+        if (!file.is_open()) {
+            throw std::runtime_error("Could not open file list: " + listFile);
+        }
+        in = &file;
+    }
+
+    std::string line;
+    while (std::getline(*in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) files.push_back(line);
+    }
+}
+
+void appendInput(const std::string& input, std::vector<std::string>& files) {
+    std::error_code error;
+    if (!fs::is_directory(input, error)) {
+        files.push_back(input);
+        return;
+    }
+
+    std::vector<std::string> found;
+    for (auto it = fs::recursive_directory_iterator(input, fs::directory_options::skip_permission_denied);
+         it != fs::recursive_directory_iterator(); ++it) {
+        if (it->is_regular_file(error)) {
+            found.push_back(it->path().string());
+        }
+    }
+    // Directory order is filesystem dependent; sort for reproducible output
+    std::sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+}
+
+} // namespace
+
+IngestPipeline::IngestPipeline(const IngestOptions& options) : options(options) {
+    if (this->options.readers == 0) this->options.readers = 1;
+    if (this->options.workers == 0) {
+        this->options.workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+std::string IngestPipeline::readFile(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open file: " + filename);
+    }
+
+    std::string content;
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    if (size > 0) {
+        content.resize(static_cast<size_t>(size));
+        file.seekg(0, std::ios::beg);
+        file.read(&content[0], size);
+        content.resize(static_cast<size_t>(file.gcount()));
+    } else {
+        // Pipes and special files do not report a size
+        file.clear();
+        file.seekg(0, std::ios::beg);
+        content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    return content;
+}
+
+std::vector<std::string> IngestPipeline::expandInputs(
+    const std::vector<std::string>& inputs,
+    const std::vector<std::string>& fileLists) {
+    std::vector<std::string> files;
+    for (const auto& input : inputs) {
+        if (input == "-") {
+            appendListFile(input, files);
+        } else {
+            appendInput(input, files);
+        }
+    }
+    for (const auto& listFile : fileLists) {
+        appendListFile(listFile, files);
+    }
+    return files;
+}
+
+void IngestPipeline::run(const std::vector<std::string>& files, const Processor& process) const {
+    BoundedQueue<PendingDocument> queue(options.queueCapacity);
+    std::atomic<size_t> nextFile{0};
+    std::atomic<size_t> bytesInFlight{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    auto fail = [&]() {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!error) error = std::current_exception();
+        failed.store(true);
+        queue.close();
+    };
+
+    auto reader = [&]() {
+        try {
+            for (size_t i = nextFile++; i < files.size() && !failed.load(); i = nextFile++) {
+                // Hold off while too much read data waits for the workers
+                std::error_code sizeError;
+                auto size = fs::file_size(files[i], sizeError);
+                size_t expected = sizeError ? 0 : static_cast<size_t>(size);
+                for (unsigned attempt = 0;
+                     bytesInFlight.load() > 0 &&
+                     bytesInFlight.load() + expected > options.maxBytesInFlight &&
+                     !failed.load();
+                     ++attempt) {
+                    BoundedQueue<PendingDocument>::backoff(attempt);
+                }
+
+                PendingDocument document;
+                document.index = i;
+                document.content = readFile(files[i]);
+                bytesInFlight += document.content.size();
+                if (!queue.push(std::move(document))) break;
+            }
+        } catch (...) {
+            fail();
+        }
+    };
+
+    auto worker = [&]() {
+        PendingDocument document;
+        while (queue.pop(document)) {
+            size_t size = document.content.size();
+            if (!failed.load()) {
+                try {
+                    process(document.index, std::move(document.content));
+                } catch (...) {
+                    fail();
+                }
+            }
+            bytesInFlight -= size;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < options.workers; ++i) workers.emplace_back(worker);
+
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < std::min(options.readers, std::max<size_t>(1, files.size())); ++i) {
+        readers.emplace_back(reader);
+    }
+
+    for (auto& thread : readers) thread.join();
+    queue.close();
+    for (auto& thread : workers) thread.join();
+
+    if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,258 @@
+#include "inverted_index.hpp"
+#include "similarity_calculator.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint32_t BLOCK = 128;
+constexpr uint32_t END = UINT32_MAX;
+
+// Float dot products may round above the real-valued bounds by about one
+// ulp per term; bounds are padded by this much per query term
+constexpr double ROUNDING_SLACK = 1.0 / (1 << 22);
+
+void appendVarint(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+uint32_t readVarint(const uint8_t*& in) {
+    uint32_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t byte = *in++;
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+}
+
+bool better(const InvertedIndex::Hit& a, const InvertedIndex::Hit& b) {
+    if (a.score != b.score) return a.score > b.score;
+    return a.document < b.document;
+}
+
+} // namespace
+
+// Walks one posting list in document order
+class InvertedIndex::Cursor {
+public:
+    Cursor(const InvertedIndex& index, const PostingList& list, float queryWeight, uint64_t& decoded)
+        : index(index), list(list), decoded(decoded), maxScore(static_cast<double>(queryWeight) * list.maxWeight) {
+        seekBlock(0);
+    }
+
+    uint32_t document() const { return current; }
+
+    // Largest contribution any document can get from this term
+    double upperBound() const { return maxScore; }
+
+    // Contribution of the current document, rounded up
+    double currentBound() const { return maxScore * quantized / 255.0; }
+
+    // Largest contribution in the block that would hold `target`, and that
+    // block's last document; the cursor does not move
+    std::pair<double, uint32_t> blockBound(uint32_t target) const {
+        const Skip* block = findBlock(target);
+        if (block == lastBlock()) return {0.0, END};
+        return {maxScore * block->maxWeight / 255.0, block->lastDocument};
+    }
+
+    void next() {
+        if (++position == list.count) {
+            current = END;
+            return;
+        }
+        decode();
+    }
+
+    // Move to the first document >= target
+    void advance(uint32_t target) {
+        if (current >= target) return;
+
+        const Skip* block = findBlock(target);
+        if (block == lastBlock()) {
+            current = END;
+            return;
+        }
+        uint32_t blockIndex = static_cast<uint32_t>(block - firstBlock());
+        if (blockIndex != position / BLOCK) seekBlock(blockIndex);
+        while (current < target) next();
+    }
+
+private:
+    const InvertedIndex& index;
+    const PostingList& list;
+    uint64_t& decoded;
+    double maxScore;
+    const uint8_t* in = nullptr;
+    uint32_t position = 0;
+    uint32_t current = 0;
+    uint8_t quantized = 0;
+
+    const Skip* firstBlock() const { return index.skips.data() + list.firstSkip; }
+    const Skip* lastBlock() const { return firstBlock() + (list.count + BLOCK - 1) / BLOCK; }
+
+    // First block, from the current one on, whose last document is >= target
+    const Skip* findBlock(uint32_t target) const {
+        return std::lower_bound(firstBlock() + position / BLOCK, lastBlock(), target,
+                                [](const Skip& skip, uint32_t doc) { return skip.lastDocument < doc; });
+    }
+
+    void seekBlock(uint32_t block) {
+        const Skip* skips = index.skips.data() + list.firstSkip;
+        position = block * BLOCK;
+        in = index.bytes.data() + skips[block].offset;
+        current = block == 0 ? 0 : skips[block - 1].lastDocument;
+        decode();
+    }
+
+    void decode() {
+        current += readVarint(in);
+        quantized = *in++;
+        ++decoded;
+    }
+};
+
+InvertedIndex::InvertedIndex(const std::vector<const TermVector*>& documents) : documents(documents) {
+    if (documents.size() >= END) {
+        throw std::invalid_argument("Too many documents for the inverted index");
+    }
+
+    // Count postings per term, then lay them out term by term
+    for (const TermVector* vector : documents) {
+        for (size_t i = 0; i < vector->keys.size(); ++i) {
+            uint32_t term = vector->keys[i];
+            if (term >= lists.size()) lists.resize(static_cast<size_t>(term) + 1);
+            ++lists[term].count;
+            lists[term].maxWeight = std::max(lists[term].maxWeight, vector->weights[i]);
+        }
+    }
+
+    std::vector<size_t> starts(lists.size() + 1, 0);
+    for (size_t term = 0; term < lists.size(); ++term) starts[term + 1] = starts[term] + lists[term].count;
+    std::vector<uint32_t> postingDocuments(starts.back());
+    std::vector<float> postingWeights(starts.back());
+    std::vector<size_t> fill(starts.begin(), starts.end() - 1);
+    for (size_t doc = 0; doc < documents.size(); ++doc) {
+        const TermVector& vector = *documents[doc];
+        for (size_t i = 0; i < vector.keys.size(); ++i) {
+            size_t slot = fill[vector.keys[i]]++;
+            postingDocuments[slot] = static_cast<uint32_t>(doc);
+            postingWeights[slot] = vector.weights[i];
+        }
+    }
+
+    for (size_t term = 0; term < lists.size(); ++term) {
+        PostingList& list = lists[term];
+        list.firstSkip = static_cast<uint32_t>(skips.size());
+        for (size_t blockStart = starts[term]; blockStart < starts[term + 1]; blockStart += BLOCK) {
+            if (bytes.size() > UINT32_MAX) {
+                throw std::length_error("Inverted index postings exceed 4 GiB");
+            }
+            size_t blockEnd = std::min<size_t>(blockStart + BLOCK, starts[term + 1]);
+            Skip skip{postingDocuments[blockEnd - 1], static_cast<uint32_t>(bytes.size()), 0};
+            for (size_t i = blockStart; i < blockEnd; ++i) {
+                uint32_t previous = i == starts[term] ? 0 : postingDocuments[i - 1];
+                appendVarint(bytes, postingDocuments[i] - previous);
+
+                // Rounded up, so the bound never falls below the real weight
+                double scaled = std::ceil(static_cast<double>(postingWeights[i]) / list.maxWeight * 255.0);
+                auto quantized = static_cast<uint8_t>(std::clamp(scaled, 1.0, 255.0));
+                bytes.push_back(quantized);
+                skip.maxWeight = std::max(skip.maxWeight, quantized);
+            }
+            skips.push_back(skip);
+        }
+    }
+}
+
+std::vector<InvertedIndex::Hit> InvertedIndex::search(const TermVector& query, size_t k,
+                                                      SearchStats* stats) const {
+    SearchStats local;
+    SearchStats& counters = stats ? *stats : local;
+    counters = SearchStats();
+
+    std::vector<Cursor> cursors;
+    for (size_t i = 0; i < query.keys.size(); ++i) {
+        uint32_t term = query.keys[i];
+        if (term < lists.size() && lists[term].count > 0) {
+            cursors.emplace_back(*this, lists[term], query.weights[i], counters.postingsDecoded);
+            counters.postings += lists[term].count;
+        }
+    }
+    const double slack = ROUNDING_SLACK * static_cast<double>(cursors.size() + 1);
+
+    std::vector<Hit> heap; // worst kept hit at the front
+    auto threshold = [&]() { return heap.size() < k ? -1.0 : heap.front().score; };
+    std::vector<Cursor*> order;
+    for (auto& cursor : cursors) order.push_back(&cursor);
+    auto byDocument = [](const Cursor* a, const Cursor* b) { return a->document() < b->document(); };
+
+    while (k > 0) {
+        std::sort(order.begin(), order.end(), byDocument);
+
+        // Pivot: the first document whose terms so far could beat the k-th hit
+        double bound = slack;
+        size_t pivot = order.size();
+        for (size_t i = 0; i < order.size() && order[i]->document() != END; ++i) {
+            bound += order[i]->upperBound();
+            if (bound > threshold()) {
+                pivot = i;
+                break;
+            }
+        }
+        if (pivot == order.size()) break;
+        uint32_t pivotDocument = order[pivot]->document();
+        size_t last = pivot;
+        while (last + 1 < order.size() && order[last + 1]->document() == pivotDocument) ++last;
+
+        // Tighter check with the blocks the pivot document would be in. If
+        // they cannot reach the k-th hit, neither can anything up to the end
+        // of the shortest of them, short of where the next list resumes.
+        double blockBound = slack;
+        uint32_t resume = last + 1 < order.size() ? order[last + 1]->document() : END;
+        for (size_t i = 0; i <= last; ++i) {
+            auto [bound, lastDocument] = order[i]->blockBound(pivotDocument);
+            blockBound += bound;
+            if (lastDocument != END) resume = std::min(resume, lastDocument + 1);
+        }
+        if (blockBound <= threshold()) {
+            for (size_t i = 0; i <= last; ++i) order[i]->advance(resume);
+            continue;
+        }
+
+        if (order[0]->document() != pivotDocument) {
+            // Nothing before the pivot can score on its own; skip ahead
+            for (size_t i = 0; i < pivot; ++i) order[i]->advance(pivotDocument);
+            continue;
+        }
+
+        // Every cursor on the pivot document is in the sorted prefix
+        double documentBound = slack;
+        for (size_t i = 0; i < order.size() && order[i]->document() == pivotDocument; ++i) {
+            documentBound += order[i]->currentBound();
+        }
+        if (documentBound > threshold()) {
+            ++counters.documentsScored;
+            Hit hit{pivotDocument, SimilarityCalculator::calculateCosineSimilarity(query, *documents[pivotDocument])};
+            if (heap.size() < k) {
+                heap.push_back(hit);
+                std::push_heap(heap.begin(), heap.end(), better);
+            } else if (better(hit, heap.front())) {
+                std::pop_heap(heap.begin(), heap.end(), better);
+                heap.back() = hit;
+                std::push_heap(heap.begin(), heap.end(), better);
+            }
+        }
+        for (size_t i = 0; i < order.size() && order[i]->document() == pivotDocument; ++i) {
+            order[i]->next();
+        }
+    }
+
+    std::sort(heap.begin(), heap.end(), better);
+    return heap;
+}
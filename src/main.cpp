@@ -1,75 +1,152 @@
-#include "text_processor.hpp"
-#include "similarity_calculator.hpp"
+#include "corpus.hpp"
+#include "result_writer.hpp"
+#include "matrix_writer.hpp"
+#include "ingest.hpp"
+#include "external_join.hpp"
 #include "shingling.hpp"
-#include "document_analyzer.hpp"
-#include <iostream>
+#include "sharding.hpp"
+#include "clustering.hpp"
+#include "sentence_index.hpp"
+#include "top_k.hpp"
+#include <algorithm>
+#include <chrono>
 #include <fstream>
+#include <iostream>
 #include <string>
 #include <vector>
 #include <iomanip>
-#include <chrono>
-
-enum class Algorithm {
-    COSINE,
-    TFIDF,
-    JACCARD_CHAR,
-    JACCARD_WORD,
-    ALL
-};
+#include <numeric>
 
 enum class OutputFormat {
     SIMPLE,
     DETAILED,
-    JSON
+    JSON,
+    NDJSON,
+    CSV,
+    BINARY
 };
 
+// Queries compared against each corpus document while it is in cache
+constexpr size_t QUERY_BATCH = 16;
+
 struct Config {
     bool ignoreStopwords = false;
     std::string stopwordsFile;
     Algorithm algorithm = Algorithm::COSINE;
     OutputFormat outputFormat = OutputFormat::SIMPLE;
     int shingleSize = 3;
+    int hammingDistance = 3;
+    SketchType sketch = SketchType::NONE;
+    double sketchError = 0.05;
     bool showTimings = false;
     bool showAnalysis = false;
     bool showSentences = false;
     double threshold = 0.0;
+    std::string outputFile;
+    std::vector<std::string> fileLists;
+    size_t threads = 0;
+    size_t readers = 2;
+    std::string matrixFile;
+    MatrixDtype matrixDtype = MatrixDtype::FLOAT32;
+    bool exact = false;
+    size_t hashDims = 0;
+    bool corpusIdf = false;
+    bool external = false;
+    size_t maxMemory = size_t(1) << 30;
+    std::string tempDir;
+    size_t maxDocumentFrequency = 0;
+    Shard shard;
+    size_t topK = 0;
+    double cascade = -1.0;
+    double cluster = -1.0;
+    bool clusterStats = false;
+    std::string sourceOf;
+    std::string search;
     std::vector<std::string> files;
+    std::vector<std::string> queries; // with --against, only query x corpus pairs
+    std::vector<std::string> queryLists;
+    std::vector<std::string> against;
+    std::vector<std::string> againstLists;
+    bool queryPairs = false;
 };
 
-std::string readFile(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        throw std::runtime_error("Could not open file: " + filename);
-    }
-    
-    std::string content((std::istreambuf_iterator<char>(file)),
-                        std::istreambuf_iterator<char>());
-    return content;
-}
-
 void printUsage() {
     std::cout << "SimText - Advanced Text Similarity Checker v2.1\n\n"
-              << "Usage: simtext [options] <file1> <file2> [file3...]\n\n"
+              << "Usage: simtext [options] <file|dir|-> [file|dir...]\n"
+              << "       simtext [options] --queries <file|dir...> --against <file|dir...>\n"
+              << "       simtext merge [--output FORMAT] [--output-file FILE] [--top-k K] [--threshold N] <shard.bin...>\n\n"
               << "Options:\n"
-              << "  --algorithm ALGO        Algorithm to use: cosine, tfidf, jaccard-char, jaccard-word, all (default: cosine)\n"
+              << "  --algorithm ALGO        Algorithm to use: cosine, tfidf, jaccard-char, jaccard-word, simhash, all (default: cosine)\n"
               << "  --ignore-stopwords      Ignore common stopwords\n"
               << "  --stopwords-file FILE   Use custom stopwords file\n"
-              << "  --output FORMAT         Output format: simple, detailed, json (default: simple)\n"
+              << "  --output FORMAT         Output format: simple, detailed, json, ndjson, csv, binary (default: simple)\n"
+              << "  --output-file FILE      Write json/ndjson/csv/binary results to FILE instead of stdout\n"
+              << "  --matrix-out FILE       Also write the score matrix to FILE (CSR when --threshold is set)\n"
+              << "  --matrix-dtype TYPE     Matrix value type: f16, f32 (default: f32)\n"
               << "  --shingle-size N        Size of shingles for Jaccard similarity (default: 3)\n"
+              << "  --hamming K             Max SimHash Hamming distance for near-duplicates (default: 3)\n"
+              << "  --sketch TYPE           Estimate Jaccard from fixed-size sketches: minhash, hll\n"
+              << "  --sketch-error E        Target 95% error of sketch estimates (default: 0.05)\n"
+              << "  --hash-dims N           Compare cosine on N-dimensional hashed float vectors\n"
+              << "  --corpus-idf            Weight TF-IDF with IDF over all input documents\n"
+              << "  --exact                 Use double-precision term maps instead of float32 vectors\n"
+              << "  --external              Out-of-core Jaccard (jaccard-char/jaccard-word) via sorted runs on disk\n"
+              << "  --max-memory SIZE       Buffer budget for --external, e.g. 512M, 4G (default: 1G)\n"
+              << "  --temp-dir DIR          Directory for --external spill files (default: system temp)\n"
+              << "  --max-df N              With --external, drop shingles found in more than N files\n"
+              << "  --shard I/N             Only compute shard I of N (0 <= I < N) of the pairs\n"
+              << "  --top-k K               Only output the K highest-scoring pairs\n"
+              << "  --cascade SCORE         Skip costlier stages once a pair's combined score cannot reach SCORE\n"
+              << "  --cluster THRESHOLD     Output groups of documents linked by scores >= THRESHOLD\n"
+              << "  --cluster-stats         Add representatives and similarity statistics to --cluster\n"
+              << "  --source-of FILE        Find which input each sentence of FILE came from\n"
+              << "  --search FILE           Top --top-k (default 10) TF-IDF matches for FILE via an inverted index\n"
+              << "  --queries FILE...       Compare the inputs that follow only against the --against inputs\n"
+              << "  --against FILE...       Inputs the queries are compared against\n"
+              << "  --query-list FILE       Read query paths from FILE, one per line (- for stdin)\n"
+              << "  --against-list FILE     Read --against paths from FILE, one per line (- for stdin)\n"
+              << "  --query-pairs           With --queries, also compare the queries with each other\n"
               << "  --threshold N           Only show results above threshold (0.0-1.0)\n"
               << "  --timing                Show execution times\n"
               << "  --analysis              Show detailed plagiarism analysis and confidence levels\n"
               << "  --sentence-check        Show sentence-level similarity analysis\n"
+              << "  --file-list FILE        Read input paths from FILE, one per line (- for stdin)\n"
+              << "  --threads N             Ingest worker threads (default: all cores)\n"
+              << "  --readers N             Prefetching file reader threads (default: 2)\n"
               << "  --help, -h              Show this help message\n\n"
               << "Examples:\n"
               << "  simtext doc1.txt doc2.txt\n"
               << "  simtext --algorithm all --output detailed --analysis doc1.txt doc2.txt\n"
               << "  simtext --analysis --sentence-check essay1.txt essay2.txt\n"
-              << "  simtext --algorithm jaccard-word --shingle-size 4 --ignore-stopwords *.txt\n";
+              << "  simtext --algorithm jaccard-word --shingle-size 4 --ignore-stopwords *.txt\n"
+              << "  simtext --shard 0/2 --output binary --output-file part0.bin docs/\n"
+              << "  simtext merge --output csv part0.bin part1.bin\n"
+              << "  simtext --algorithm jaccard-char --cluster 0.8 --cluster-stats docs/\n"
+              << "  simtext --source-of submission.txt archive/\n"
+              << "  simtext --search submission.txt --top-k 20 archive/\n"
+              << "  simtext --queries new/ --against archive/ --threshold 0.4\n";
+}
+
+// "512M" style sizes with binary K/M/G suffixes
+size_t parseByteSize(const std::string& text) {
+    size_t used = 0;
+    double value = std::stod(text, &used);
+    std::string suffix = text.substr(used);
+    double scale = 1.0;
+    if (suffix == "K" || suffix == "k") scale = 1024.0;
+    else if (suffix == "M" || suffix == "m") scale = 1024.0 * 1024;
+    else if (suffix == "G" || suffix == "g") scale = 1024.0 * 1024 * 1024;
+    else if (!suffix.empty()) {
+        std::cerr << "Unknown size suffix: " << text << "\n";
+        exit(1);
+    }
+    return static_cast<size_t>(value * scale);
 }
 
 Config parseArguments(const std::vector<std::string>& args) {
     Config config;
+    // Plain inputs, or the queries or corpus after --queries / --against
+    std::vector<std::string>* inputs = &config.files;
     
     for (size_t i = 0; i < args.size(); ++i) {
         if (args[i] == "--help" || args[i] == "-h") {
@@ -88,6 +165,7 @@ Config parseArguments(const std::vector<std::string>& args) {
             else if (algo == "tfidf") config.algorithm = Algorithm::TFIDF;
             else if (algo == "jaccard-char") config.algorithm = Algorithm::JACCARD_CHAR;
             else if (algo == "jaccard-word") config.algorithm = Algorithm::JACCARD_WORD;
+            else if (algo == "simhash") config.algorithm = Algorithm::SIMHASH;
             else if (algo == "all") config.algorithm = Algorithm::ALL;
             else {
                 std::cerr << "Unknown algorithm: " << algo << "\n";
@@ -99,14 +177,109 @@ Config parseArguments(const std::vector<std::string>& args) {
             if (format == "simple") config.outputFormat = OutputFormat::SIMPLE;
             else if (format == "detailed") config.outputFormat = OutputFormat::DETAILED;
             else if (format == "json") config.outputFormat = OutputFormat::JSON;
+            else if (format == "ndjson") config.outputFormat = OutputFormat::NDJSON;
+            else if (format == "csv") config.outputFormat = OutputFormat::CSV;
+            else if (format == "binary") config.outputFormat = OutputFormat::BINARY;
             else {
                 std::cerr << "Unknown output format: " << format << "\n";
                 exit(1);
             }
         }
+        else if (args[i] == "--output-file" && i + 1 < args.size()) {
+            config.outputFile = args[++i];
+        }
+        else if (args[i] == "--matrix-out" && i + 1 < args.size()) {
+            config.matrixFile = args[++i];
+        }
+        else if (args[i] == "--matrix-dtype" && i + 1 < args.size()) {
+            std::string dtype = args[++i];
+            if (dtype == "f16") config.matrixDtype = MatrixDtype::FLOAT16;
+            else if (dtype == "f32") config.matrixDtype = MatrixDtype::FLOAT32;
+            else {
+                std::cerr << "Unknown matrix dtype: " << dtype << "\n";
+                exit(1);
+            }
+        }
         else if (args[i] == "--shingle-size" && i + 1 < args.size()) {
             config.shingleSize = std::stoi(args[++i]);
         }
+        else if (args[i] == "--hamming" && i + 1 < args.size()) {
+            config.hammingDistance = std::stoi(args[++i]);
+        }
+        else if (args[i] == "--sketch" && i + 1 < args.size()) {
+            std::string sketch = args[++i];
+            if (sketch == "minhash") config.sketch = SketchType::MINHASH;
+            else if (sketch == "hll") config.sketch = SketchType::HLL;
+            else {
+                std::cerr << "Unknown sketch type: " << sketch << "\n";
+                exit(1);
+            }
+        }
+        else if (args[i] == "--sketch-error" && i + 1 < args.size()) {
+            config.sketchError = std::stod(args[++i]);
+        }
+        else if (args[i] == "--hash-dims" && i + 1 < args.size()) {
+            config.hashDims = std::stoul(args[++i]);
+        }
+        else if (args[i] == "--corpus-idf") {
+            config.corpusIdf = true;
+        }
+        else if (args[i] == "--exact") {
+            config.exact = true;
+        }
+        else if (args[i] == "--external") {
+            config.external = true;
+        }
+        else if (args[i] == "--max-memory" && i + 1 < args.size()) {
+            config.maxMemory = parseByteSize(args[++i]);
+        }
+        else if (args[i] == "--temp-dir" && i + 1 < args.size()) {
+            config.tempDir = args[++i];
+        }
+        else if (args[i] == "--max-df" && i + 1 < args.size()) {
+            config.maxDocumentFrequency = std::stoul(args[++i]);
+        }
+        else if (args[i] == "--shard" && i + 1 < args.size()) {
+            try {
+                config.shard = Shard::parse(args[++i]);
+            } catch (const std::invalid_argument& e) {
+                std::cerr << e.what() << "\n";
+                exit(1);
+            }
+        }
+        else if (args[i] == "--top-k" && i + 1 < args.size()) {
+            config.topK = std::stoul(args[++i]);
+        }
+        else if (args[i] == "--cascade" && i + 1 < args.size()) {
+            config.cascade = std::stod(args[++i]);
+        }
+        else if (args[i] == "--cluster" && i + 1 < args.size()) {
+            config.cluster = std::stod(args[++i]);
+        }
+        else if (args[i] == "--cluster-stats") {
+            config.clusterStats = true;
+        }
+        else if (args[i] == "--source-of" && i + 1 < args.size()) {
+            config.sourceOf = args[++i];
+        }
+        else if (args[i] == "--search" && i + 1 < args.size()) {
+            config.search = args[++i];
+        }
+        else if (args[i] == "--queries") {
+            inputs = &config.queries;
+        }
+        else if (args[i] == "--against") {
+            inputs = &config.against;
+        }
+        else if (args[i] == "--query-list" && i + 1 < args.size()) {
+            config.queryLists.push_back(args[++i]);
+        }
+        else if (args[i] == "--against-list" && i + 1 < args.size()) {
+            config.againstLists.push_back(args[++i]);
+        }
+        else if (args[i] == "--query-pairs") {
+            config.queryPairs = true;
+        }
         else if (args[i] == "--threshold" && i + 1 < args.size()) {
             config.threshold = std::stod(args[++i]);
         }
@@ -119,123 +292,118 @@ Config parseArguments(const std::vector<std::string>& args) {
         else if (args[i] == "--sentence-check") {
             config.showSentences = true;
         }
-        else if (args[i][0] != '-') {
-            config.files.push_back(args[i]);
+        else if (args[i] == "--file-list" && i + 1 < args.size()) {
+            config.fileLists.push_back(args[++i]);
+        }
+        else if (args[i] == "--threads" && i + 1 < args.size()) {
+            config.threads = std::stoul(args[++i]);
+        }
+        else if (args[i] == "--readers" && i + 1 < args.size()) {
+            config.readers = std::stoul(args[++i]);
+        }
+        else if (args[i] == "-" || args[i][0] != '-') {
+            inputs->push_back(args[i]);
         }
     }
     
     return config;
 }
 
-struct SimilarityResult {
-    double cosine = 0.0;
-    double tfidf = 0.0;
-    double jaccardChar = 0.0;
-    double jaccardWord = 0.0;
-    double duration = 0.0;
-    DocumentStats stats1;
-    DocumentStats stats2;
-    SimilarityConfidence confidence;
-    std::vector<std::pair<double, std::string>> sentenceSimilarities;
-};
+CompareOptions toCompareOptions(const Config& config) {
+    CompareOptions options;
+    options.algorithm = config.algorithm;
+    options.shingleSize = config.shingleSize;
+    options.sketch = config.sketch;
+    options.sketchError = config.sketchError;
+    options.exact = config.exact;
+    options.hashDims = config.hashDims;
+    options.corpusIdf = config.corpusIdf;
+    options.analysis = config.showAnalysis;
+    options.sentences = config.showSentences;
+    options.cascade = config.cascade;
+    // Clustering only needs pairs whose primary score reaches the cluster
+    // threshold. --threshold is not passed on: it filters on the best of all
+    // scores, which any stage not run yet could still raise.
+    if (config.cluster > 0) options.primaryThreshold = config.cluster;
+    return options;
+}
 
-SimilarityResult calculateSimilarity(const std::string& file1, const std::string& file2, 
-                                   const Config& config, TextProcessor& processor) {
-    auto start = std::chrono::high_resolution_clock::now();
-    
-    SimilarityResult result;
-    
-    // Read files
-    std::string content1 = readFile(file1);
-    std::string content2 = readFile(file2);
-    
-    // Calculate TF maps
-    auto tf1 = processor.getTermFrequencyMap(content1);
-    auto tf2 = processor.getTermFrequencyMap(content2);
-    
-    // Cosine similarity
-    if (config.algorithm == Algorithm::COSINE || config.algorithm == Algorithm::ALL) {
-        result.cosine = SimilarityCalculator::calculateCosineSimilarity(tf1, tf2);
-    }
-    
-    // TF-IDF similarity
-    if (config.algorithm == Algorithm::TFIDF || config.algorithm == Algorithm::ALL) {
-        std::vector<std::unordered_map<std::string, double>> docs = {tf1, tf2};
-        auto idf = SimilarityCalculator::calculateIdf(docs);
-        result.tfidf = SimilarityCalculator::calculateTfIdfCosineSimilarity(tf1, tf2, idf);
-    }
-    
-    // Jaccard similarities
-    if (config.algorithm == Algorithm::JACCARD_CHAR || config.algorithm == Algorithm::ALL) {
-        auto shingles1 = ShinglingCalculator::generateCharacterShingles(content1, config.shingleSize);
-        auto shingles2 = ShinglingCalculator::generateCharacterShingles(content2, config.shingleSize);
-        result.jaccardChar = ShinglingCalculator::calculateJaccardSimilarity(shingles1, shingles2);
+// Sorted, deduplicated shingle keys for --external
+std::vector<uint64_t> externalShingles(const std::string& content, const Config& config,
+                                       const TextProcessor& processor) {
+    if (config.algorithm == Algorithm::JACCARD_CHAR) {
+        return ShinglingCalculator::generatePackedCharacterShingles(content, config.shingleSize);
     }
-    
-    if (config.algorithm == Algorithm::JACCARD_WORD || config.algorithm == Algorithm::ALL) {
-        auto tokens1 = processor.processText(content1);
-        auto tokens2 = processor.processText(content2);
-        auto shingles1 = ShinglingCalculator::generateWordShingles(tokens1, config.shingleSize);
-        auto shingles2 = ShinglingCalculator::generateWordShingles(tokens2, config.shingleSize);
-        result.jaccardWord = ShinglingCalculator::calculateJaccardSimilarity(shingles1, shingles2);
+    return ShinglingCalculator::generateHashedWordShingles(
+        processor.processText(content), config.shingleSize);
+}
+
+bool usesRecordWriter(OutputFormat format) {
+    return format == OutputFormat::JSON || format == OutputFormat::NDJSON ||
+           format == OutputFormat::CSV || format == OutputFormat::BINARY;
+}
+
+ClusterFormat toClusterFormat(OutputFormat format) {
+    switch (format) {
+        case OutputFormat::JSON: return ClusterFormat::JSON;
+        case OutputFormat::NDJSON: return ClusterFormat::NDJSON;
+        case OutputFormat::CSV: return ClusterFormat::CSV;
+        default: return ClusterFormat::TEXT;
     }
-    
-    // Document analysis
-    if (config.showAnalysis) {
-        auto tokens1 = processor.processText(content1);
-        auto tokens2 = processor.processText(content2);
-        result.stats1 = DocumentAnalyzer::analyzeDocument(content1, tokens1);
-        result.stats2 = DocumentAnalyzer::analyzeDocument(content2, tokens2);
-        result.confidence = DocumentAnalyzer::analyzeSimilarityConfidence(
-            result.cosine, result.tfidf, result.jaccardChar, result.jaccardWord);
+}
+
+RecordFormat toRecordFormat(OutputFormat format) {
+    switch (format) {
+        case OutputFormat::NDJSON: return RecordFormat::NDJSON;
+        case OutputFormat::CSV: return RecordFormat::CSV;
+        case OutputFormat::BINARY: return RecordFormat::BINARY;
+        default: return RecordFormat::JSON;
     }
-    
-    // Sentence-level analysis
-    if (config.showSentences) {
-        result.sentenceSimilarities = DocumentAnalyzer::analyzeSentenceSimilarity(content1, content2);
+}
+
+unsigned scoreFields(Algorithm algorithm) {
+    switch (algorithm) {
+        case Algorithm::COSINE: return SCORE_COSINE;
+        case Algorithm::TFIDF: return SCORE_TFIDF;
+        case Algorithm::JACCARD_CHAR: return SCORE_JACCARD_CHAR;
+        case Algorithm::JACCARD_WORD: return SCORE_JACCARD_WORD;
+        case Algorithm::SIMHASH: return SCORE_SIMHASH;
+        default: return SCORE_COSINE | SCORE_TFIDF | SCORE_JACCARD_CHAR | SCORE_JACCARD_WORD;
     }
-    
-    auto end = std::chrono::high_resolution_clock::now();
-    result.duration = std::chrono::duration<double, std::milli>(end - start).count();
-    
-    return result;
+}
+
+PairRecord toPairRecord(size_t doc1, size_t doc2, const SimilarityResult& result) {
+    PairRecord record;
+    record.doc1 = static_cast<uint32_t>(doc1);
+    record.doc2 = static_cast<uint32_t>(doc2);
+    record.cosine = result.cosine;
+    record.tfidf = result.tfidf;
+    record.jaccardChar = result.jaccardChar;
+    record.jaccardWord = result.jaccardWord;
+    record.simhash = result.simhash;
+    record.duration = result.duration;
+    record.skipped = result.skipped & (SCORE_COSINE | SCORE_TFIDF | SCORE_JACCARD_CHAR | SCORE_JACCARD_WORD);
+    return record;
+}
+
+// Detailed-output line for a stage the cascade did not run
+bool reportSkipped(const char* label, const SimilarityResult& result, unsigned stage) {
+    if (!(result.skipped & stage)) return false;
+    std::cout << label << "skipped (cascade)\n";
+    return true;
 }
 
 void outputResults(const std::string& file1, const std::string& file2, 
                   const SimilarityResult& result, const Config& config) {
     
     // Check threshold
-    double maxSimilarity = std::max({result.cosine, result.tfidf, result.jaccardChar, result.jaccardWord});
+    double maxSimilarity = std::max({result.cosine, result.tfidf, result.jaccardChar,
+                                      result.jaccardWord, result.simhash});
     if (maxSimilarity < config.threshold) {
         return;
     }
     
-    if (config.outputFormat == OutputFormat::JSON) {
-        std::cout << "{\n"
-                  << "  \"file1\": \"" << file1 << "\",\n"
-                  << "  \"file2\": \"" << file2 << "\",\n"
-                  << "  \"similarity\": {\n";
-        
-        if (config.algorithm == Algorithm::COSINE || config.algorithm == Algorithm::ALL) {
-            std::cout << "    \"cosine\": " << std::fixed << std::setprecision(4) << result.cosine << ",\n";
-        }
-        if (config.algorithm == Algorithm::TFIDF || config.algorithm == Algorithm::ALL) {
-            std::cout << "    \"tfidf\": " << std::fixed << std::setprecision(4) << result.tfidf << ",\n";
-        }
-        if (config.algorithm == Algorithm::JACCARD_CHAR || config.algorithm == Algorithm::ALL) {
-            std::cout << "    \"jaccard_char\": " << std::fixed << std::setprecision(4) << result.jaccardChar << ",\n";
-        }
-        if (config.algorithm == Algorithm::JACCARD_WORD || config.algorithm == Algorithm::ALL) {
-            std::cout << "    \"jaccard_word\": " << std::fixed << std::setprecision(4) << result.jaccardWord << ",\n";
-        }
-        
-        std::cout << "  },\n";
-        if (config.showTimings) {
-            std::cout << "  \"duration_ms\": " << std::fixed << std::setprecision(2) << result.duration << "\n";
-        }
-        std::cout << "}\n";
-        
-    } else if (config.outputFormat == OutputFormat::DETAILED) {
+    if (config.outputFormat == OutputFormat::DETAILED) {
         std::cout << "=== Similarity Analysis ===\n"
                   << "File 1: " << file1 << "\n"
                   << "File 2: " << file2 << "\n\n";
@@ -243,14 +411,29 @@ void outputResults(const std::string& file1, const std::string& file2,
         if (config.algorithm == Algorithm::COSINE || config.algorithm == Algorithm::ALL) {
             std::cout << "Cosine Similarity:      " << std::fixed << std::setprecision(2) << result.cosine * 100 << "%\n";
         }
-        if (config.algorithm == Algorithm::TFIDF || config.algorithm == Algorithm::ALL) {
+        if ((config.algorithm == Algorithm::TFIDF || config.algorithm == Algorithm::ALL) &&
+            !reportSkipped("TF-IDF Similarity:      ", result, STAGE_TFIDF)) {
             std::cout << "TF-IDF Similarity:      " << std::fixed << std::setprecision(2) << result.tfidf * 100 << "%\n";
         }
-        if (config.algorithm == Algorithm::JACCARD_CHAR || config.algorithm == Algorithm::ALL) {
-            std::cout << "Jaccard (Character):    " << std::fixed << std::setprecision(2) << result.jaccardChar * 100 << "%\n";
+        if ((config.algorithm == Algorithm::JACCARD_CHAR || config.algorithm == Algorithm::ALL) &&
+            !reportSkipped("Jaccard (Character):    ", result, STAGE_JACCARD_CHAR)) {
+            std::cout << "Jaccard (Character):    " << std::fixed << std::setprecision(2) << result.jaccardChar * 100 << "%";
+            if (config.sketch != SketchType::NONE) {
+                std::cout << " (±" << std::setprecision(2) << result.jaccardCharMargin * 100 << "%)";
+            }
+            std::cout << "\n";
+        }
+        if ((config.algorithm == Algorithm::JACCARD_WORD || config.algorithm == Algorithm::ALL) &&
+            !reportSkipped("Jaccard (Word):         ", result, STAGE_JACCARD_WORD)) {
+            std::cout << "Jaccard (Word):         " << std::fixed << std::setprecision(2) << result.jaccardWord * 100 << "%";
+            if (config.sketch != SketchType::NONE) {
+                std::cout << " (±" << std::setprecision(2) << result.jaccardWordMargin * 100 << "%)";
+            }
+            std::cout << "\n";
         }
-        if (config.algorithm == Algorithm::JACCARD_WORD || config.algorithm == Algorithm::ALL) {
-            std::cout << "Jaccard (Word):         " << std::fixed << std::setprecision(2) << result.jaccardWord * 100 << "%\n";
+        if (config.algorithm == Algorithm::SIMHASH) {
+            std::cout << "SimHash Similarity:     " << std::fixed << std::setprecision(2) << result.simhash * 100
+                      << "% (Hamming distance " << result.hammingDistance << ")\n";
         }
         
         if (config.showTimings) {
@@ -264,6 +447,9 @@ void outputResults(const std::string& file1, const std::string& file2,
         }
         
         // Show sentence similarities
+        if (config.showSentences && (result.skipped & STAGE_SENTENCES)) {
+            std::cout << "Sentence-level analysis skipped (cascade)\n";
+        }
         if (config.showSentences && !result.sentenceSimilarities.empty()) {
             std::cout << "=== HIGH SIMILARITY SENTENCES ===\n";
             for (size_t i = 0; i < std::min(size_t(5), result.sentenceSimilarities.size()); ++i) {
@@ -296,6 +482,10 @@ void outputResults(const std::string& file1, const std::string& file2,
                 similarity = result.jaccardWord;
                 algorithmName = "Jaccard (Word)";
                 break;
+            case Algorithm::SIMHASH:
+                similarity = result.simhash;
+                algorithmName = "SimHash";
+                break;
             default:
                 similarity = result.cosine;
                 algorithmName = "Cosine";
@@ -310,6 +500,187 @@ void outputResults(const std::string& file1, const std::string& file2,
     }
 }
 
+// --source-of: the best matching input sentences for each sentence of one
+// document, from a MinHash LSH index over every input sentence
+void findSources(const Config& config, const TextProcessor& processor, const IngestPipeline& pipeline) {
+    SentenceIndexOptions options;
+    if (config.threshold > 0) options.minSimilarity = config.threshold;
+    if (config.topK > 0) options.maxSources = config.topK;
+    SentenceIndex index(options, processor);
+    pipeline.run(config.files, [&](size_t document, std::string&& content) {
+        index.addDocument(static_cast<uint32_t>(document), content);
+    });
+    
+    std::string query = IngestPipeline::readFile(config.sourceOf);
+    auto matches = index.query(query);
+    
+    std::ofstream file;
+    std::ostream* out = &std::cout;
+    if (usesRecordWriter(config.outputFormat) && !config.outputFile.empty() && config.outputFile != "-") {
+        file.open(config.outputFile, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Could not open output file: " + config.outputFile);
+        }
+        out = &file;
+    }
+    
+    std::string buffer;
+    if (config.outputFormat == OutputFormat::CSV) {
+        buffer += "offset,length,file,source_offset,source_length,similarity\n";
+    } else if (config.outputFormat == OutputFormat::JSON) {
+        buffer += '[';
+    }
+    for (size_t i = 0; i < matches.size(); ++i) {
+        const auto& match = matches[i];
+        std::string sentence = query.substr(match.offset, match.length);
+        if (config.outputFormat == OutputFormat::JSON || config.outputFormat == OutputFormat::NDJSON) {
+            if (config.outputFormat == OutputFormat::JSON) buffer += i == 0 ? "\n  " : ",\n  ";
+            buffer += "{\"offset\":" + std::to_string(match.offset) +
+                      ",\"length\":" + std::to_string(match.length) + ",\"sentence\":";
+            appendJsonString(buffer, sentence);
+            buffer += ",\"sources\":[";
+            for (size_t j = 0; j < match.sources.size(); ++j) {
+                const auto& source = match.sources[j];
+                buffer += j == 0 ? "{\"file\":" : ",{\"file\":";
+                appendJsonString(buffer, config.files[source.document]);
+                buffer += ",\"offset\":" + std::to_string(source.offset) +
+                          ",\"length\":" + std::to_string(source.length) + ",\"similarity\":";
+                appendFixed(buffer, source.similarity, 4);
+                buffer += '}';
+            }
+            buffer += "]}";
+            if (config.outputFormat == OutputFormat::NDJSON) buffer += '\n';
+        } else if (config.outputFormat == OutputFormat::CSV) {
+            for (const auto& source : match.sources) {
+                buffer += std::to_string(match.offset) + "," + std::to_string(match.length) + ",";
+                appendCsvField(buffer, config.files[source.document]);
+                buffer += "," + std::to_string(source.offset) + "," + std::to_string(source.length) + ",";
+                appendFixed(buffer, source.similarity, 4);
+                buffer += '\n';
+            }
+        } else {
+            buffer += "Sentence at byte " + std::to_string(match.offset) + ": \"" + sentence + "\"\n";
+            for (const auto& source : match.sources) {
+                buffer += "  ";
+                appendFixed(buffer, source.similarity * 100, 1);
+                buffer += "%  " + config.files[source.document] + " at byte " +
+                          std::to_string(source.offset) + "\n";
+            }
+        }
+    }
+    if (config.outputFormat == OutputFormat::JSON) {
+        buffer += matches.empty() ? "]\n" : "\n]\n";
+    } else if (!usesRecordWriter(config.outputFormat) && matches.empty()) {
+        buffer += "No sentence sources found\n";
+    }
+    out->write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    out->flush();
+}
+
+// Each document is read and tokenized once, overlapping I/O and CPU. Large
+// documents are also split across threads, so a few huge inputs do not
+// leave most cores idle.
+void loadCorpus(Corpus& corpus, const Config& config, const IngestPipeline& pipeline) {
+    std::vector<DocumentProfile> profiles(config.files.size());
+    ThreadExecutor chunks(config.threads);
+    pipeline.run(config.files, [&](size_t index, std::string&& content) {
+        profiles[index] = corpus.buildProfile(std::move(content), &chunks);
+    });
+    for (auto& profile : profiles) {
+        corpus.add(std::move(profile));
+    }
+    profiles.clear();
+    corpus.finalize();
+}
+
+// --search: exact top-k TF-IDF cosine matches for one document, from an
+// inverted index over the inputs
+void runSearch(Config config, const TextProcessor& processor, const IngestPipeline& pipeline) {
+    config.algorithm = Algorithm::TFIDF;
+    CompareOptions options = toCompareOptions(config);
+    options.corpusIdf = true;
+    options.searchIndex = true;
+    Corpus corpus(options, processor);
+    loadCorpus(corpus, config, pipeline);
+    
+    std::string query = IngestPipeline::readFile(config.search);
+    SearchStats stats;
+    auto start = std::chrono::high_resolution_clock::now();
+    auto matches = corpus.search(query, config.topK > 0 ? config.topK : 10, &stats);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    
+    // The query is reported as one more input after the indexed ones
+    size_t queryId = config.files.size();
+    if (usesRecordWriter(config.outputFormat)) {
+        std::vector<std::string> names = config.files;
+        names.push_back(config.search);
+        WriterOptions writerOptions;
+        writerOptions.fields = SCORE_TFIDF;
+        writerOptions.threshold = config.threshold;
+        writerOptions.showTimings = config.showTimings;
+        auto writer = ResultWriter::create(toRecordFormat(config.outputFormat),
+                                           config.outputFile, names, writerOptions);
+        for (const auto& match : matches) {
+            writer->write(toPairRecord(queryId, match.document, match.result));
+        }
+        writer->finish();
+    } else {
+        for (const auto& match : matches) {
+            outputResults(config.search, config.files[match.document], match.result, config);
+        }
+    }
+    
+    if (config.showTimings) {
+        std::cerr << "Search: " << std::fixed << std::setprecision(2) << elapsed.count() << " ms, "
+                  << stats.postingsDecoded << " of " << stats.postings << " postings decoded, "
+                  << stats.documentsScored << " documents scored\n";
+    }
+}
+
+// `simtext merge`: combine the binary outputs of --shard runs
+int runMerge(const std::vector<std::string>& args) {
+    MergeOptions options;
+    std::vector<std::string> inputs;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == "--output" && i + 1 < args.size()) {
+            std::string format = args[++i];
+            if (format == "json") options.format = RecordFormat::JSON;
+            else if (format == "ndjson") options.format = RecordFormat::NDJSON;
+            else if (format == "csv") options.format = RecordFormat::CSV;
+            else if (format == "binary") options.format = RecordFormat::BINARY;
+            else {
+                std::cerr << "Merge output format must be json, ndjson, csv or binary\n";
+                return 1;
+            }
+        }
+        else if (args[i] == "--output-file" && i + 1 < args.size()) {
+            options.outputFile = args[++i];
+        }
+        else if (args[i] == "--top-k" && i + 1 < args.size()) {
+            options.topK = std::stoul(args[++i]);
+        }
+        else if (args[i] == "--threshold" && i + 1 < args.size()) {
+            options.threshold = std::stod(args[++i]);
+        }
+        else if (args[i] == "--help" || args[i] == "-h") {
+            printUsage();
+            return 0;
+        }
+        else {
+            inputs.push_back(args[i]);
+        }
+    }
+    
+    try {
+        ShardMerger::merge(inputs, options);
+        return 0;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
+
 int main(int argc, char* argv[]) {
     std::vector<std::string> args(argv + 1, argv + argc);
     
@@ -318,15 +689,83 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
-    Config config = parseArguments(args);
-    
-    if (config.files.size() < 2) {
-        std::cerr << "Error: Please provide at least two files to compare\n";
-        printUsage();
-        return 1;
+    if (args[0] == "merge") {
+        return runMerge(std::vector<std::string>(args.begin() + 1, args.end()));
     }
     
+    Config config = parseArguments(args);
+    
     try {
+        // With --queries, the queries come first in the input list and the
+        // corpus after them
+        size_t queryCount = 0;
+        bool bipartite = !config.queries.empty() || !config.queryLists.empty() ||
+                         !config.against.empty() || !config.againstLists.empty();
+        if (bipartite) {
+            if (!config.files.empty() || !config.fileLists.empty()) {
+                std::cerr << "Error: Inputs must follow --queries or --against when either is used\n";
+                return 1;
+            }
+            if (config.external || config.shard.count > 1 || !config.search.empty() || !config.sourceOf.empty()) {
+                std::cerr << "Error: --queries cannot be combined with --external, --shard, --search or --source-of\n";
+                return 1;
+            }
+            config.files = IngestPipeline::expandInputs(config.queries, config.queryLists);
+            queryCount = config.files.size();
+            auto against = IngestPipeline::expandInputs(config.against, config.againstLists);
+            if (queryCount == 0 || against.empty()) {
+                std::cerr << "Error: --queries and --against each need at least one file\n";
+                return 1;
+            }
+            config.files.insert(config.files.end(), against.begin(), against.end());
+        }
+        
+        // Directories and file lists become a flat list of paths
+        if (!bipartite) config.files = IngestPipeline::expandInputs(config.files, config.fileLists);
+        if (config.files.size() < (config.sourceOf.empty() && config.search.empty() ? 2u : 1u)) {
+            std::cerr << "Error: Please provide at least two files to compare\n";
+            printUsage();
+            return 1;
+        }
+        
+        if (config.external && config.algorithm != Algorithm::JACCARD_CHAR &&
+            config.algorithm != Algorithm::JACCARD_WORD) {
+            std::cerr << "Error: --external supports jaccard-char and jaccard-word\n";
+            return 1;
+        }
+        
+        if (config.shard.count > 1 && (config.external || !config.matrixFile.empty())) {
+            std::cerr << "Error: --shard cannot be combined with --external or --matrix-out\n";
+            return 1;
+        }
+        
+        if (!config.search.empty() && (config.external || config.shard.count > 1 || config.cluster >= 0 ||
+                                       !config.sourceOf.empty() || !config.matrixFile.empty() ||
+                                       config.exact || config.showAnalysis || config.showSentences)) {
+            std::cerr << "Error: --search cannot be combined with --external, --shard, --cluster, --source-of, "
+                         "--matrix-out, --exact, --analysis or --sentence-check\n";
+            return 1;
+        }
+        
+        if (!config.sourceOf.empty() && (config.external || config.shard.count > 1 ||
+                                         config.cluster >= 0 || !config.matrixFile.empty() ||
+                                         config.outputFormat == OutputFormat::BINARY)) {
+            std::cerr << "Error: --source-of cannot be combined with --external, --shard, --cluster, --matrix-out or binary output\n";
+            return 1;
+        }
+        
+        if (config.cluster >= 0 && (config.shard.count > 1 || config.topK > 0 ||
+                                    !config.matrixFile.empty() ||
+                                    config.outputFormat == OutputFormat::BINARY)) {
+            std::cerr << "Error: --cluster cannot be combined with --shard, --top-k, --matrix-out or binary output\n";
+            return 1;
+        }
+        
+        IngestOptions ingestOptions;
+        ingestOptions.workers = config.threads;
+        ingestOptions.readers = config.readers;
+        IngestPipeline pipeline(ingestOptions);
+        
         // Configure text processor
         TextProcessor processor;
         processor.setIgnoreStopwords(config.ignoreStopwords);
@@ -334,12 +773,150 @@ int main(int argc, char* argv[]) {
             processor.loadStopwords(config.stopwordsFile);
         }
         
-        // Compare all pairs of files
-        for (size_t i = 0; i < config.files.size(); ++i) {
-            for (size_t j = i + 1; j < config.files.size(); ++j) {
-                auto result = calculateSimilarity(config.files[i], config.files[j], config, processor);
+        if (!config.sourceOf.empty()) {
+            findSources(config, processor, pipeline);
+            return 0;
+        }
+        if (!config.search.empty()) {
+            runSearch(config, processor, pipeline);
+            return 0;
+        }
+        
+        // Structured formats go through a buffered writer thread
+        std::unique_ptr<ResultWriter> writer;
+        if (usesRecordWriter(config.outputFormat) && config.cluster < 0) {
+            WriterOptions options;
+            options.fields = scoreFields(config.algorithm);
+            options.threshold = config.threshold;
+            options.showTimings = config.showTimings;
+            writer = ResultWriter::create(toRecordFormat(config.outputFormat),
+                                          config.outputFile, config.files, options);
+        }
+        
+        std::unique_ptr<MatrixWriter> matrix;
+        if (!config.matrixFile.empty()) {
+            matrix = std::make_unique<MatrixWriter>(
+                config.matrixFile, static_cast<uint32_t>(config.files.size()),
+                config.matrixDtype, config.threshold);
+        }
+        
+        auto output = [&](size_t i, size_t j, const SimilarityResult& result) {
+            if (writer) {
+                writer->write(toPairRecord(i, j, result));
+            } else {
                 outputResults(config.files[i], config.files[j], result, config);
             }
+        };
+        
+        // With --top-k, pairs passing the threshold compete for K slots and
+        // are output best first at the end
+        TopK<SimilarityResult> best(config.topK);
+        
+        // With --cluster, pairs only feed the union-find and are never stored
+        std::unique_ptr<ClusterBuilder> clusters;
+        if (config.cluster >= 0) {
+            clusters = std::make_unique<ClusterBuilder>(config.files.size(), config.cluster);
+        }
+        
+        auto emit = [&](size_t i, size_t j, const SimilarityResult& result) {
+            if (clusters) {
+                clusters->addPair(static_cast<uint32_t>(i), static_cast<uint32_t>(j),
+                                  primaryScore(result, config.algorithm));
+                return;
+            }
+            // The matrix gets every scored pair; --top-k only limits the listing
+            if (matrix) {
+                matrix->set(static_cast<uint32_t>(i), static_cast<uint32_t>(j),
+                            primaryScore(result, config.algorithm));
+            }
+            if (config.topK == 0) {
+                output(i, j, result);
+                return;
+            }
+            PairRecord record = toPairRecord(i, j, result);
+            if (ResultWriter::maxScore(record, scoreFields(config.algorithm)) >= config.threshold) {
+                best.push(primaryScore(result, config.algorithm), record.doc1, record.doc2, result);
+            }
+        };
+        
+        if (config.external) {
+            // Shingle postings go through sorted runs on disk instead of memory
+            ExternalOptions externalOptions;
+            externalOptions.maxMemory = config.maxMemory;
+            externalOptions.maxDocumentFrequency = config.maxDocumentFrequency;
+            externalOptions.tempDir = config.tempDir;
+            ExternalJaccard join(config.files.size(), externalOptions);
+            pipeline.run(config.files, [&](size_t index, std::string&& content) {
+                join.addDocument(static_cast<uint32_t>(index), externalShingles(content, config, processor));
+            });
+            join.run([&](uint32_t doc1, uint32_t doc2, double jaccard) {
+                SimilarityResult result;
+                if (config.algorithm == Algorithm::JACCARD_CHAR) {
+                    result.jaccardChar = jaccard;
+                } else {
+                    result.jaccardWord = jaccard;
+                }
+                emit(doc1, doc2, result);
+            });
+        } else {
+            Corpus corpus(toCompareOptions(config), processor);
+            loadCorpus(corpus, config, pipeline);
+            
+            if (config.algorithm == Algorithm::SIMHASH) {
+                // Near-duplicate search only visits pairs sharing a fingerprint block
+                for (const auto& pair : corpus.nearDuplicates(config.hammingDistance)) {
+                    if (!config.shard.owns(pair.doc1, pair.doc2)) continue;
+                    if (queryCount > 0 && (pair.doc1 >= queryCount ||
+                                           (pair.doc2 < queryCount && !config.queryPairs))) continue;
+                    emit(pair.doc1, pair.doc2, corpus.compare(pair.doc1, pair.doc2));
+                }
+            } else if (queryCount > 0) {
+                // Only the query x corpus block; corpus profiles are shared
+                // read-only and streamed once per batch of queries
+                if (config.queryPairs) {
+                    for (uint32_t i = 0; i < queryCount; ++i) {
+                        for (uint32_t j = i + 1; j < queryCount; ++j) {
+                            emit(i, j, corpus.compare(i, j));
+                        }
+                    }
+                }
+                std::vector<Corpus::DocumentId> queries(queryCount);
+                std::vector<Corpus::DocumentId> documents(corpus.size() - queryCount);
+                std::iota(queries.begin(), queries.end(), 0);
+                std::iota(documents.begin(), documents.end(), static_cast<Corpus::DocumentId>(queryCount));
+                ThreadExecutor executor(config.threads);
+                corpus.compareBatched(queries, documents, QUERY_BATCH, [&](const Corpus::Comparison& pair) {
+                    emit(pair.doc1, pair.doc2, pair.result);
+                }, &executor);
+            } else if (clusters) {
+                // Rows are scored in parallel straight into the union-find
+                ThreadExecutor executor(config.threads);
+                executor.parallelFor(corpus.size(), [&](size_t i) {
+                    for (size_t j = i + 1; j < corpus.size(); ++j) {
+                        emit(i, j, corpus.compare(static_cast<uint32_t>(i), static_cast<uint32_t>(j)));
+                    }
+                });
+            } else {
+                // Compare all pairs of files, or this shard's slice of them
+                PairPartition::forEachPair(corpus.size(), config.shard, [&](uint32_t i, uint32_t j) {
+                    emit(i, j, corpus.compare(i, j));
+                });
+            }
+        }
+        
+        for (const auto& entry : best.take()) {
+            output(entry.doc1, entry.doc2, entry.value);
+        }
+        
+        if (clusters) {
+            ClusterWriter::write(clusters->clusters(), config.files, toClusterFormat(config.outputFormat),
+                                 config.outputFile, config.clusterStats);
+        }
+        if (writer) {
+            writer->finish();
+        }
+        if (matrix) {
+            matrix->finish();
         }
         
         return 0;
@@ -0,0 +1,297 @@
+#include "matrix_writer.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t TILE_ENTRIES = 1 << 16;
+const uint64_t SECTION_ALIGN = 64;
+
+uint64_t alignUp(uint64_t value) {
+    return (value + SECTION_ALIGN - 1) / SECTION_ALIGN * SECTION_ALIGN;
+}
+
+// The file is little-endian on every host, so integers are stored byte by byte
+void storeUint(unsigned char* out, uint64_t value, size_t size) {
+    for (size_t k = 0; k < size; ++k) out[k] = static_cast<unsigned char>(value >> (8 * k));
+}
+
+uint32_t loadUint32(const unsigned char* in) {
+    return static_cast<uint32_t>(in[0]) | static_cast<uint32_t>(in[1]) << 8 |
+           static_cast<uint32_t>(in[2]) << 16 | static_cast<uint32_t>(in[3]) << 24;
+}
+
+void storeHeader(unsigned char* out, const MatrixFileHeader& header) {
+    uint32_t threshold;
+    std::memcpy(&threshold, &header.threshold, sizeof(threshold));
+    std::memcpy(out, header.magic, sizeof(header.magic));
+    storeUint(out + 4, header.version, 4);
+    storeUint(out + 8, header.layout, 4);
+    storeUint(out + 12, header.itemSize, 4);
+    storeUint(out + 16, header.n, 8);
+    storeUint(out + 24, header.nnz, 8);
+    storeUint(out + 32, header.dataOffset, 8);
+    storeUint(out + 40, header.indicesOffset, 8);
+    storeUint(out + 48, header.indptrOffset, 8);
+    storeUint(out + 56, threshold, 4);
+    storeUint(out + 60, header.reserved, 4);
+}
+
+} // namespace
+
+MatrixWriter::MatrixWriter(const std::string& path, uint32_t documentCount,
+                           MatrixDtype dtype, double threshold)
+    : path(path), spillPath(path + ".spill"), n(documentCount), dtype(dtype),
+      layout(threshold > 0.0 ? MatrixLayout::CSR : MatrixLayout::DENSE_UPPER),
+      threshold(static_cast<float>(threshold)) {
+    tile.reserve(TILE_ENTRIES);
+
+    if (layout == MatrixLayout::DENSE_UPPER) {
+        // The dense layout has a fixed size, so map it up front
+        uint64_t itemSize = dtype == MatrixDtype::FLOAT16 ? 2 : 4;
+        uint64_t pairs = static_cast<uint64_t>(n) * (n > 0 ? n - 1 : 0) / 2;
+        mapFile(sizeof(MatrixFileHeader) + pairs * itemSize);
+    } else {
+        spill = std::fopen(spillPath.c_str(), "w+b");
+        if (!spill) {
+            throw std::runtime_error("Could not create spill file: " + spillPath);
+        }
+    }
+}
+
+MatrixWriter::~MatrixWriter() {
+    unmapFile();
+    if (spill) {
+        std::fclose(spill);
+        std::remove(spillPath.c_str());
+    }
+}
+
+uint64_t MatrixWriter::denseIndex(uint64_t n, uint64_t i, uint64_t j) {
+    return i * (2 * n - i - 1) / 2 + (j - i - 1);
+}
+
+uint16_t MatrixWriter::toHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    uint32_t exponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (exponent == 0xFF) { // Inf or NaN
+        return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+    }
+
+    int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+    if (halfExponent >= 0x1F) { // Overflow to infinity
+        return sign | 0x7C00;
+    }
+
+    if (halfExponent <= 0) { // Subnormal or zero
+        if (halfExponent < -10) return sign;
+        mantissa |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) ++half;
+        return sign | static_cast<uint16_t>(half);
+    }
+
+    uint32_t half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) ++half; // May carry into exponent
+    return sign | static_cast<uint16_t>(half);
+}
+
+void MatrixWriter::set(uint32_t i, uint32_t j, double value) {
+    if (i > j) std::swap(i, j);
+    if (i == j || j >= n) {
+        throw std::out_of_range("Matrix pair index out of range");
+    }
+
+    float score = static_cast<float>(value);
+    if (layout == MatrixLayout::CSR && score < threshold) {
+        return;
+    }
+
+    tile.push_back({i, j, score});
+    if (tile.size() >= TILE_ENTRIES) {
+        flushTile();
+    }
+}
+
+void MatrixWriter::storeValue(unsigned char* data, uint64_t index, float value) const {
+    if (dtype == MatrixDtype::FLOAT16) {
+        storeUint(data + index * 2, toHalf(value), 2);
+    } else {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        storeUint(data + index * 4, bits, 4);
+    }
+}
+
+void MatrixWriter::flushTile() {
+    if (tile.empty()) return;
+
+    if (layout == MatrixLayout::DENSE_UPPER) {
+        // Apply in file order so each tile touches the mapping sequentially
+        std::sort(tile.begin(), tile.end(), [](const Entry& a, const Entry& b) {
+            return a.row != b.row ? a.row < b.row : a.col < b.col;
+        });
+        unsigned char* data = mapping + sizeof(MatrixFileHeader);
+        for (const auto& entry : tile) {
+            storeValue(data, denseIndex(n, entry.row, entry.col), entry.value);
+        }
+    } else {
+        if (std::fwrite(tile.data(), sizeof(Entry), tile.size(), spill) != tile.size()) {
+            throw std::runtime_error("Failed to write spill file: " + spillPath);
+        }
+        spilled += tile.size();
+    }
+
+    tile.clear();
+}
+
+void MatrixWriter::finish() {
+    if (finished) return;
+    finished = true;
+
+    flushTile();
+    if (layout == MatrixLayout::DENSE_UPPER) {
+        finishDense();
+    } else {
+        finishSparse();
+    }
+    if (!unmapFile()) {
+        throw std::runtime_error("Failed to write matrix file: " + path);
+    }
+}
+
+void MatrixWriter::finishDense() {
+    MatrixFileHeader header = {};
+    std::memcpy(header.magic, "STXM", 4);
+    header.version = 1;
+    header.layout = static_cast<uint32_t>(MatrixLayout::DENSE_UPPER);
+    header.itemSize = dtype == MatrixDtype::FLOAT16 ? 2 : 4;
+    header.n = n;
+    header.nnz = static_cast<uint64_t>(n) * (n > 0 ? n - 1 : 0) / 2;
+    header.dataOffset = sizeof(MatrixFileHeader);
+    storeHeader(mapping, header);
+}
+
+void MatrixWriter::finishSparse() {
+    uint64_t itemSize = dtype == MatrixDtype::FLOAT16 ? 2 : 4;
+
+    // Pass 1: row counts, turned into the CSR row pointer
+    std::vector<uint64_t> indptr(static_cast<size_t>(n) + 1, 0);
+    std::vector<Entry> buffer(TILE_ENTRIES);
+    std::rewind(spill);
+    for (uint64_t done = 0; done < spilled;) {
+        size_t count = std::fread(buffer.data(), sizeof(Entry), buffer.size(), spill);
+        if (count == 0) throw std::runtime_error("Truncated spill file: " + spillPath);
+        for (size_t k = 0; k < count; ++k) ++indptr[buffer[k].row + 1];
+        done += count;
+    }
+    for (size_t row = 0; row < n; ++row) indptr[row + 1] += indptr[row];
+
+    MatrixFileHeader header = {};
+    std::memcpy(header.magic, "STXM", 4);
+    header.version = 1;
+    header.layout = static_cast<uint32_t>(MatrixLayout::CSR);
+    header.itemSize = static_cast<uint32_t>(itemSize);
+    header.n = n;
+    header.nnz = spilled;
+    header.threshold = threshold;
+    header.indptrOffset = sizeof(MatrixFileHeader);
+    header.indicesOffset = alignUp(header.indptrOffset + (static_cast<uint64_t>(n) + 1) * sizeof(uint64_t));
+    header.dataOffset = alignUp(header.indicesOffset + spilled * sizeof(uint32_t));
+    mapFile(header.dataOffset + spilled * itemSize);
+
+    storeHeader(mapping, header);
+    for (size_t row = 0; row < indptr.size(); ++row) {
+        storeUint(mapping + header.indptrOffset + row * sizeof(uint64_t), indptr[row], sizeof(uint64_t));
+    }
+
+    // Pass 2: scatter entries into their rows
+    unsigned char* indices = mapping + header.indicesOffset;
+    unsigned char* data = mapping + header.dataOffset;
+    std::vector<uint64_t> cursor(indptr.begin(), indptr.end() - 1);
+    std::rewind(spill);
+    for (uint64_t done = 0; done < spilled;) {
+        size_t count = std::fread(buffer.data(), sizeof(Entry), buffer.size(), spill);
+        if (count == 0) throw std::runtime_error("Truncated spill file: " + spillPath);
+        for (size_t k = 0; k < count; ++k) {
+            uint64_t pos = cursor[buffer[k].row]++;
+            storeUint(indices + pos * sizeof(uint32_t), buffer[k].col, sizeof(uint32_t));
+            storeValue(data, pos, buffer[k].value);
+        }
+        done += count;
+    }
+
+    // Rows must be sorted by column for CSR consumers
+    std::vector<std::pair<uint32_t, uint32_t>> row;
+    std::vector<unsigned char> values;
+    for (size_t r = 0; r < n; ++r) {
+        uint64_t begin = indptr[r];
+        uint64_t end = indptr[r + 1];
+        row.clear();
+        for (uint64_t k = begin; k < end; ++k) {
+            row.emplace_back(loadUint32(indices + k * sizeof(uint32_t)), static_cast<uint32_t>(k - begin));
+        }
+        if (std::is_sorted(row.begin(), row.end())) continue;
+
+        std::sort(row.begin(), row.end());
+        values.assign(data + begin * itemSize, data + end * itemSize);
+        for (size_t k = 0; k < row.size(); ++k) {
+            storeUint(indices + (begin + k) * sizeof(uint32_t), row[k].first, sizeof(uint32_t));
+            std::memcpy(data + (begin + k) * itemSize, &values[row[k].second * itemSize], itemSize);
+        }
+    }
+
+    std::fclose(spill);
+    spill = nullptr;
+    std::remove(spillPath.c_str());
+}
+
+void MatrixWriter::mapFile(uint64_t size) {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open matrix file: " + path);
+    }
+    // Reserve the blocks now: running out of space while writing through the
+    // mapping would raise SIGBUS instead of an error
+    if (::posix_fallocate(fd, 0, static_cast<off_t>(size)) != 0) {
+        ::close(fd);
+        fd = -1;
+        throw std::runtime_error("Could not allocate matrix file: " + path);
+    }
+
+    void* addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        ::close(fd);
+        fd = -1;
+        throw std::runtime_error("Could not map matrix file: " + path);
+    }
+    mapping = static_cast<unsigned char*>(addr);
+    mappedSize = size;
+}
+
+bool MatrixWriter::unmapFile() {
+    bool written = true;
+    if (mapping) {
+        written = ::msync(mapping, mappedSize, MS_SYNC) == 0;
+        ::munmap(mapping, mappedSize);
+        mapping = nullptr;
+    }
+    if (fd >= 0) {
+        written = ::close(fd) == 0 && written;
+        fd = -1;
+    }
+    return written;
+}
@@ -0,0 +1,457 @@
+#include "result_writer.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+const char BINARY_MAGIC[4] = {'S', 'T', 'X', 'R'};
+const uint32_t BINARY_VERSION = 1;
+
+struct FieldInfo {
+    ScoreField field;
+    const char* name;
+    double PairRecord::*member;
+};
+
+const FieldInfo FIELDS[] = {
+    {SCORE_COSINE, "cosine", &PairRecord::cosine},
+    {SCORE_TFIDF, "tfidf", &PairRecord::tfidf},
+    {SCORE_JACCARD_CHAR, "jaccard_char", &PairRecord::jaccardChar},
+    {SCORE_JACCARD_WORD, "jaccard_word", &PairRecord::jaccardWord},
+    {SCORE_SIMHASH, "simhash", &PairRecord::simhash},
+};
+
+const size_t MAX_FIELDS = sizeof(FIELDS) / sizeof(FIELDS[0]);
+
+// Values are stored little-endian whatever the host byte order
+void appendUint32(std::string& out, uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        out += static_cast<char>((value >> shift) & 0xFF);
+    }
+}
+
+void appendFloat(std::string& out, float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    appendUint32(out, bits);
+}
+
+uint32_t decodeUint32(const unsigned char* bytes) {
+    return static_cast<uint32_t>(bytes[0]) | static_cast<uint32_t>(bytes[1]) << 8 |
+           static_cast<uint32_t>(bytes[2]) << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+}
+
+// Shared by the JSON and NDJSON writers, which differ only in framing
+void appendJsonObject(std::string& out, const PairRecord& record,
+                      const std::vector<std::string>& names, const WriterOptions& options) {
+    out += "{\"file1\":";
+    appendJsonString(out, names[record.doc1]);
+    out += ",\"file2\":";
+    appendJsonString(out, names[record.doc2]);
+    out += ",\"similarity\":{";
+
+    bool first = true;
+    for (const auto& info : FIELDS) {
+        if (!(options.fields & info.field)) continue;
+        if (!first) out += ',';
+        first = false;
+        out += '"';
+        out += info.name;
+        out += "\":";
+        if (record.skipped & info.field) {
+            out += "null";
+        } else {
+            appendFixed(out, record.*info.member, 4);
+        }
+    }
+    out += '}';
+
+    if (options.showTimings) {
+        out += ",\"duration_ms\":";
+        appendFixed(out, record.duration, 2);
+    }
+    out += '}';
+}
+
+class JsonResultWriter final : public ResultWriter {
+public:
+    JsonResultWriter(const std::string& path, const std::vector<std::string>& names,
+                     const WriterOptions& options)
+        : ResultWriter(names, options) {
+        begin(path, false);
+    }
+
+protected:
+    void formatHeader(std::string& out) override { out += '['; }
+
+    void formatRecord(const PairRecord& record, std::string& out) override {
+        out += first ? "\n  " : ",\n  ";
+        first = false;
+        appendJsonObject(out, record, names, options);
+    }
+
+    void formatFooter(std::string& out) override { out += first ? "]\n" : "\n]\n"; }
+
+private:
+    bool first = true;
+};
+
+class NdjsonResultWriter final : public ResultWriter {
+public:
+    NdjsonResultWriter(const std::string& path, const std::vector<std::string>& names,
+                       const WriterOptions& options)
+        : ResultWriter(names, options) {
+        begin(path, false);
+    }
+
+protected:
+    void formatRecord(const PairRecord& record, std::string& out) override {
+        appendJsonObject(out, record, names, options);
+        out += '\n';
+    }
+};
+
+class CsvResultWriter final : public ResultWriter {
+public:
+    CsvResultWriter(const std::string& path, const std::vector<std::string>& names,
+                    const WriterOptions& options)
+        : ResultWriter(names, options) {
+        begin(path, false);
+    }
+
+protected:
+    void formatHeader(std::string& out) override {
+        out += "file1,file2";
+        for (const auto& info : FIELDS) {
+            if (options.fields & info.field) {
+                out += ',';
+                out += info.name;
+            }
+        }
+        if (options.showTimings) out += ",duration_ms";
+        out += '\n';
+    }
+
+    void formatRecord(const PairRecord& record, std::string& out) override {
+        appendCsvField(out, names[record.doc1]);
+        out += ',';
+        appendCsvField(out, names[record.doc2]);
+        for (const auto& info : FIELDS) {
+            if (options.fields & info.field) {
+                out += ',';
+                if (!(record.skipped & info.field)) {
+                    appendFixed(out, record.*info.member, 4);
+                }
+            }
+        }
+        if (options.showTimings) {
+            out += ',';
+            appendFixed(out, record.duration, 2);
+        }
+        out += '\n';
+    }
+};
+
+class BinaryResultWriter final : public ResultWriter {
+public:
+    BinaryResultWriter(const std::string& path, const std::vector<std::string>& names,
+                       const WriterOptions& options)
+        : ResultWriter(names, options) {
+        begin(path, true);
+    }
+
+protected:
+    void formatHeader(std::string& out) override {
+        out.append(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+        appendUint32(out, BINARY_VERSION);
+        appendUint32(out, options.fields);
+        appendUint32(out, static_cast<uint32_t>(names.size()));
+        for (const auto& name : names) {
+            appendUint32(out, static_cast<uint32_t>(name.size()));
+            out += name;
+        }
+    }
+
+    void formatRecord(const PairRecord& record, std::string& out) override {
+        appendUint32(out, record.doc1);
+        appendUint32(out, record.doc2);
+        for (const auto& info : FIELDS) {
+            if (!(options.fields & info.field)) continue;
+            if (record.skipped & info.field) {
+                appendFloat(out, std::numeric_limits<float>::quiet_NaN());
+            } else {
+                appendFloat(out, static_cast<float>(record.*info.member));
+            }
+        }
+    }
+};
+
+bool readExact(std::FILE* file, void* data, size_t size) {
+    return std::fread(data, 1, size, file) == size;
+}
+
+bool readUint32(std::FILE* file, uint32_t& value) {
+    unsigned char bytes[sizeof(value)];
+    if (!readExact(file, bytes, sizeof(bytes))) return false;
+    value = decodeUint32(bytes);
+    return true;
+}
+
+} // namespace
+
+void appendFixed(std::string& out, double value, int precision) {
+    char buffer[64];
+    auto res = std::to_chars(buffer, buffer + sizeof(buffer), value,
+                             std::chars_format::fixed, precision);
+    out.append(buffer, res.ptr);
+}
+
+void appendCsvField(std::string& out, const std::string& text) {
+    if (text.find_first_of(",\"\n\r") == std::string::npos) {
+        out += text;
+        return;
+    }
+    out += '"';
+    for (char c : text) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    out += '"';
+}
+
+void appendJsonString(std::string& out, const std::string& text) {
+    static const char HEX[] = "0123456789abcdef";
+    out += '"';
+    for (unsigned char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    out += "\\u00";
+                    out += HEX[c >> 4];
+                    out += HEX[c & 0xF];
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    out += '"';
+}
+
+std::unique_ptr<ResultWriter> ResultWriter::create(
+    RecordFormat format, const std::string& path,
+    const std::vector<std::string>& names, const WriterOptions& options) {
+    switch (format) {
+        case RecordFormat::JSON:
+            return std::make_unique<JsonResultWriter>(path, names, options);
+        case RecordFormat::NDJSON:
+            return std::make_unique<NdjsonResultWriter>(path, names, options);
+        case RecordFormat::CSV:
+            return std::make_unique<CsvResultWriter>(path, names, options);
+        case RecordFormat::BINARY:
+            return std::make_unique<BinaryResultWriter>(path, names, options);
+    }
+    throw std::invalid_argument("Unknown record format");
+}
+
+ResultWriter::ResultWriter(const std::vector<std::string>& names, const WriterOptions& options)
+    : names(names), options(options) {}
+
+ResultWriter::~ResultWriter() {
+    // The derived formatter is already gone here, so an unfinished writer
+    // only flushes what it has; callers wanting the footer call finish()
+    try {
+        shutdown(false);
+    } catch (...) {
+    }
+}
+
+void ResultWriter::begin(const std::string& path, bool binary) {
+    if (path.empty() || path == "-") {
+        file = stdout;
+    } else {
+        file = std::fopen(path.c_str(), binary ? "wb" : "w");
+        if (!file) {
+            throw std::runtime_error("Could not open output file: " + path);
+        }
+        ownsFile = true;
+    }
+
+    current.reserve(options.bufferSize + 4096);
+    pending.reserve(options.bufferSize + 4096);
+    formatHeader(current);
+    writerThread = std::thread(&ResultWriter::writerLoop, this);
+}
+
+double ResultWriter::maxScore(const PairRecord& record, unsigned fields) {
+    double best = 0.0;
+    for (const auto& info : FIELDS) {
+        if (fields & info.field) {
+            best = std::max(best, record.*info.member);
+        }
+    }
+    return best;
+}
+
+double ResultWriter::primaryScore(const PairRecord& record, unsigned fields) {
+    for (const auto& info : FIELDS) {
+        if (fields & info.field) {
+            return record.*info.member;
+        }
+    }
+    return 0.0;
+}
+
+bool ResultWriter::write(const PairRecord& record) {
+    // Filter before formatting so rejected pairs cost nothing
+    if (maxScore(record, options.fields) < options.threshold) {
+        return false;
+    }
+
+    formatRecord(record, current);
+    if (current.size() >= options.bufferSize) {
+        submit();
+    }
+    return true;
+}
+
+void ResultWriter::submit() {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this] { return !hasPending; });
+    std::swap(current, pending);
+    hasPending = true;
+    cv.notify_all();
+}
+
+void ResultWriter::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cv.wait(lock, [this] { return hasPending || stopping; });
+        if (!hasPending) break;
+
+        // Write without holding the lock so formatting can continue
+        lock.unlock();
+        // A short write (e.g. a full disk) is reported by finish()
+        if (std::fwrite(pending.data(), 1, pending.size(), file) != pending.size()) {
+            writeFailed = true;
+        }
+        pending.clear();
+        lock.lock();
+
+        hasPending = false;
+        cv.notify_all();
+    }
+}
+
+void ResultWriter::finish() {
+    shutdown(true);
+}
+
+void ResultWriter::shutdown(bool withFooter) {
+    if (finished || !file) return;
+    finished = true;
+
+    if (withFooter) {
+        formatFooter(current);
+    }
+    if (!current.empty()) {
+        submit();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    writerThread.join();
+
+    bool failed = writeFailed || std::fflush(file) != 0 || std::ferror(file) != 0;
+    if (ownsFile) {
+        failed = std::fclose(file) != 0 || failed;
+    }
+    file = nullptr;
+    if (failed) {
+        throw std::runtime_error("Failed to write results");
+    }
+}
+
+BinaryResultReader::BinaryResultReader(const std::string& path) {
+    file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        throw std::runtime_error("Could not open result file: " + path);
+    }
+
+    char magic[4];
+    uint32_t version = 0;
+    uint32_t fields = 0;
+    uint32_t count = 0;
+    if (!readExact(file, magic, sizeof(magic)) ||
+        std::memcmp(magic, BINARY_MAGIC, sizeof(magic)) != 0 ||
+        !readUint32(file, version) || !readUint32(file, fields) || !readUint32(file, count)) {
+        std::fclose(file);
+        throw std::runtime_error("Not a SimText binary result file: " + path);
+    }
+    if (version != BINARY_VERSION) {
+        // Also catches files written in big-endian byte order
+        std::fclose(file);
+        throw std::runtime_error("Unsupported result file version or byte order: " + path);
+    }
+    hdr.fields = fields;
+
+    hdr.names.resize(count);
+    for (auto& name : hdr.names) {
+        uint32_t length = 0;
+        if (!readUint32(file, length)) {
+            std::fclose(file);
+            throw std::runtime_error("Truncated result file header: " + path);
+        }
+        name.resize(length);
+        if (length > 0 && !readExact(file, &name[0], length)) {
+            std::fclose(file);
+            throw std::runtime_error("Truncated result file header: " + path);
+        }
+    }
+
+    for (const auto& info : FIELDS) {
+        if (hdr.fields & info.field) ++fieldCount;
+    }
+}
+
+BinaryResultReader::~BinaryResultReader() {
+    if (file) std::fclose(file);
+}
+
+bool BinaryResultReader::next(PairRecord& record) {
+    unsigned char buffer[2 * sizeof(uint32_t) + MAX_FIELDS * sizeof(float)];
+    size_t size = 2 * sizeof(uint32_t) + fieldCount * sizeof(float);
+    if (!readExact(file, buffer, size)) {
+        return false;
+    }
+
+    record = PairRecord();
+    record.doc1 = decodeUint32(buffer);
+    record.doc2 = decodeUint32(buffer + sizeof(uint32_t));
+    const unsigned char* p = buffer + 2 * sizeof(uint32_t);
+    for (const auto& info : FIELDS) {
+        if (hdr.fields & info.field) {
+            uint32_t bits = decodeUint32(p);
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            if (std::isnan(value)) {
+                record.skipped |= info.field;
+            } else {
+                record.*info.member = value;
+            }
+            p += sizeof(value);
+        }
+    }
+    return true;
+}
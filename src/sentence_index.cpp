@@ -0,0 +1,131 @@
+#include "sentence_index.hpp"
+#include "document_analyzer.hpp"
+#include "hashing.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// Jaccard of two sorted, deduplicated hash ranges
+double jaccard(const uint64_t* a, size_t sizeA, const uint64_t* b, size_t sizeB) {
+    size_t i = 0, j = 0, shared = 0;
+    while (i < sizeA && j < sizeB) {
+        if (a[i] == b[j]) {
+            ++shared;
+            ++i;
+            ++j;
+        } else if (a[i] < b[j]) {
+            ++i;
+        } else {
+            ++j;
+        }
+    }
+    size_t united = sizeA + sizeB - shared;
+    return united == 0 ? 0.0 : static_cast<double>(shared) / united;
+}
+
+} // namespace
+
+SentenceIndex::SentenceIndex(const SentenceIndexOptions& options, const TextProcessor& processor)
+    : options(options), processor(processor) {
+    if (options.bands == 0 || options.rows == 0) {
+        throw std::invalid_argument("Sentence index needs at least one band and row");
+    }
+    for (uint32_t i = 0; i < options.bands * options.rows; ++i) {
+        seeds.push_back(mix64(0x5e17e9ce0000ULL + i));
+    }
+}
+
+std::vector<SentenceIndex::Signature> SentenceIndex::signatures(const std::string& content) const {
+    std::vector<Signature> result;
+    std::vector<uint64_t> minimums(seeds.size());
+    for (const auto& [offset, length] : DocumentAnalyzer::findSentences(content)) {
+        if (length < options.minLength) continue;
+
+        Signature signature;
+        signature.offset = offset;
+        signature.length = length;
+        for (const auto& token : processor.processText(content.substr(offset, length))) {
+            signature.words.push_back(hashBytes(token.data(), token.size()));
+        }
+        std::sort(signature.words.begin(), signature.words.end());
+        signature.words.erase(std::unique(signature.words.begin(), signature.words.end()),
+                              signature.words.end());
+        if (signature.words.empty()) continue;
+
+        std::fill(minimums.begin(), minimums.end(), UINT64_MAX);
+        for (uint64_t word : signature.words) {
+            for (size_t i = 0; i < seeds.size(); ++i) {
+                minimums[i] = std::min(minimums[i], mix64(word ^ seeds[i]));
+            }
+        }
+
+        // Each band's rows hash to one key; the band number keeps bands apart
+        for (uint32_t band = 0; band < options.bands; ++band) {
+            uint64_t key = mix64(band + 1);
+            for (uint32_t row = 0; row < options.rows; ++row) {
+                key = mix64(key ^ minimums[band * options.rows + row]);
+            }
+            signature.bandKeys.push_back(key);
+        }
+        result.push_back(std::move(signature));
+    }
+    return result;
+}
+
+void SentenceIndex::addDocument(uint32_t document, const std::string& content) {
+    // Signatures are the expensive part and need no lock
+    std::vector<Signature> computed = signatures(content);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& signature : computed) {
+        if (sentences.size() >= UINT32_MAX) {
+            throw std::runtime_error("Sentence index is full");
+        }
+        auto id = static_cast<uint32_t>(sentences.size());
+        sentences.push_back({document, static_cast<uint32_t>(signature.length), signature.offset,
+                             words.size(), words.size() + signature.words.size()});
+        words.insert(words.end(), signature.words.begin(), signature.words.end());
+        for (uint64_t key : signature.bandKeys) {
+            buckets[key].push_back(id);
+        }
+    }
+}
+
+std::vector<SentenceMatch> SentenceIndex::query(const std::string& content) const {
+    std::vector<SentenceMatch> matches;
+    std::vector<uint32_t> candidates;
+    for (const auto& signature : signatures(content)) {
+        candidates.clear();
+        for (uint64_t key : signature.bandKeys) {
+            auto bucket = buckets.find(key);
+            if (bucket != buckets.end()) {
+                candidates.insert(candidates.end(), bucket->second.begin(), bucket->second.end());
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+        SentenceMatch match{signature.offset, signature.length, {}};
+        for (uint32_t id : candidates) {
+            const Sentence& stored = sentences[id];
+            double similarity = jaccard(signature.words.data(), signature.words.size(),
+                                        words.data() + stored.wordsBegin,
+                                        stored.wordsEnd - stored.wordsBegin);
+            if (similarity >= options.minSimilarity) {
+                match.sources.push_back({stored.document, stored.offset, stored.length, similarity});
+            }
+        }
+        if (match.sources.empty()) continue;
+
+        // Best first, then in corpus order so equal scores come out the same way every run
+        std::sort(match.sources.begin(), match.sources.end(), [](const auto& a, const auto& b) {
+            if (a.similarity != b.similarity) return a.similarity > b.similarity;
+            if (a.document != b.document) return a.document < b.document;
+            return a.offset < b.offset;
+        });
+        if (match.sources.size() > options.maxSources) match.sources.resize(options.maxSources);
+        matches.push_back(std::move(match));
+    }
+    return matches;
+}
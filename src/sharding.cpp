@@ -0,0 +1,138 @@
+#include "sharding.hpp"
+#include "hashing.hpp"
+#include "top_k.hpp"
+#include <algorithm>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+
+Shard Shard::parse(const std::string& text) {
+    size_t slash = text.find('/');
+    if (slash == std::string::npos || slash == 0 || slash + 1 == text.size()) {
+        throw std::invalid_argument("Shard must look like i/n: " + text);
+    }
+
+    Shard shard;
+    try {
+        shard.index = static_cast<uint32_t>(std::stoul(text.substr(0, slash)));
+        shard.count = static_cast<uint32_t>(std::stoul(text.substr(slash + 1)));
+    } catch (const std::exception&) {
+        throw std::invalid_argument("Shard must look like i/n: " + text);
+    }
+    if (shard.count == 0 || shard.index >= shard.count) {
+        throw std::invalid_argument("Shard index must be in [0, n): " + text);
+    }
+    return shard;
+}
+
+bool Shard::owns(uint32_t doc1, uint32_t doc2) const {
+    return mix64(static_cast<uint64_t>(doc1) << 32 | doc2) % count == index;
+}
+
+uint64_t PairPartition::pairCount(uint64_t documents) {
+    return documents < 2 ? 0 : documents * (documents - 1) / 2;
+}
+
+uint64_t PairPartition::rowStart(uint64_t documents, uint64_t row) {
+    // Rows before `row` hold (n-1) + (n-2) + ... + (n-row) pairs
+    return row * (documents - 1) - row * (row - 1) / 2;
+}
+
+std::pair<uint64_t, uint64_t> PairPartition::range(uint64_t documents, const Shard& shard) {
+    // The first `extra` shards take one pair more than the rest
+    uint64_t total = pairCount(documents);
+    uint64_t base = total / shard.count;
+    uint64_t extra = total % shard.count;
+    uint64_t first = shard.index * base + std::min<uint64_t>(shard.index, extra);
+    uint64_t size = base + (shard.index < extra ? 1 : 0);
+    return {first, first + size};
+}
+
+std::pair<uint32_t, uint32_t> PairPartition::pairAt(uint64_t documents, uint64_t index) {
+    if (index >= pairCount(documents)) {
+        throw std::out_of_range("Pair index out of range");
+    }
+
+    // Last row whose start is <= index
+    uint64_t low = 0, high = documents - 1;
+    while (high - low > 1) {
+        uint64_t middle = low + (high - low) / 2;
+        if (rowStart(documents, middle) <= index) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    uint64_t row = rowStart(documents, high) <= index ? high : low;
+    uint64_t column = row + 1 + (index - rowStart(documents, row));
+    return {static_cast<uint32_t>(row), static_cast<uint32_t>(column)};
+}
+
+size_t ShardMerger::merge(const std::vector<std::string>& inputs, const MergeOptions& options) {
+    if (inputs.empty()) {
+        throw std::invalid_argument("No shard files to merge");
+    }
+
+    std::vector<std::unique_ptr<BinaryResultReader>> readers;
+    for (const auto& path : inputs) {
+        readers.push_back(std::make_unique<BinaryResultReader>(path));
+        const auto& header = readers.back()->header();
+        const auto& first = readers.front()->header();
+        if (header.fields != first.fields || header.names != first.names) {
+            throw std::runtime_error("Shard " + path + " belongs to a different job than " + inputs.front());
+        }
+    }
+
+    const auto& header = readers.front()->header();
+    WriterOptions writerOptions;
+    writerOptions.fields = header.fields;
+    writerOptions.threshold = options.threshold;
+    auto writer = ResultWriter::create(options.format, options.outputFile, header.names, writerOptions);
+
+    // Each shard is sorted by (doc1, doc2), so a k-way merge restores the
+    // order of a single run. Shards written with a top-K are best first
+    // instead, which only a top-K merge accepts, since it ranks every pair.
+    using Head = std::pair<PairRecord, size_t>;
+    auto later = [](const Head& a, const Head& b) {
+        if (a.first.doc1 != b.first.doc1) return a.first.doc1 > b.first.doc1;
+        return a.first.doc2 > b.first.doc2;
+    };
+    std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+    std::vector<std::pair<uint32_t, uint32_t>> previous(readers.size());
+    auto advance = [&](size_t i) {
+        PairRecord record;
+        if (!readers[i]->next(record)) return;
+        std::pair<uint32_t, uint32_t> pair(record.doc1, record.doc2);
+        if (options.topK == 0 && pair < previous[i]) {
+            throw std::runtime_error("Shard " + inputs[i] + " is not sorted by document pair; "
+                                     "shards written with --top-k can only be merged with --top-k");
+        }
+        previous[i] = pair;
+        heads.emplace(record, i);
+    };
+    for (size_t i = 0; i < readers.size(); ++i) advance(i);
+
+    size_t written = 0;
+    TopK<PairRecord> best(options.topK);
+    while (!heads.empty()) {
+        Head head = heads.top();
+        heads.pop();
+        const PairRecord& record = head.first;
+        if (options.topK > 0) {
+            if (ResultWriter::maxScore(record, header.fields) >= options.threshold) {
+                best.push(ResultWriter::primaryScore(record, header.fields),
+                          record.doc1, record.doc2, record);
+            }
+        } else if (writer->write(record)) {
+            ++written;
+        }
+
+        advance(head.second);
+    }
+
+    for (const auto& entry : best.take()) {
+        if (writer->write(entry.value)) ++written;
+    }
+    writer->finish();
+    return written;
+}
@@ -1,14 +1,119 @@
 #include "shingling.hpp"
+#include "utf8.hpp"
+#include "hashing.hpp"
 #include <algorithm>
+#include <iterator>
 #include <sstream>
 #include <cctype>
 
-std::string ShinglingCalculator::normalizeText(const std::string& text) {
+namespace {
+
+// Byte-indexed ASCII mapping: alphanumerics lowercased, whitespace to ' ',
+// everything else dropped (0)
+struct AsciiNormalizeTable {
+    char map[128];
+    
+    AsciiNormalizeTable() {
+        for (int c = 0; c < 128; ++c) {
+            if (std::isalnum(c)) map[c] = static_cast<char>(std::tolower(c));
+            else if (std::isspace(c)) map[c] = ' ';
+            else map[c] = 0;
+        }
+    }
+};
+
+const AsciiNormalizeTable ASCII_NORMALIZE;
+
+const uint64_t HASHED_KEY_BIT = 1ULL << 63;
+const size_t RADIX_MIN_SIZE = 256;
+
+// Big-endian packing keeps shorter strings distinct from full-width keys:
+// a full key never has a zero leading byte
+uint64_t packBytes(std::string_view bytes) {
+    uint64_t key = 0;
+    for (char c : bytes) key = (key << 8) | static_cast<unsigned char>(c);
+    return key;
+}
+
+uint64_t shingleKey(std::string_view shingle, bool ascii, int w) {
+    if (ascii && w <= 8) return packBytes(shingle);
+    return hashBytes(shingle.data(), shingle.size()) | HASHED_KEY_BIT;
+}
+
+// Jaccard of two sorted, deduplicated vectors
+template <typename T>
+double sortedJaccard(const std::vector<T>& shingles1, const std::vector<T>& shingles2) {
+    if (shingles1.empty() && shingles2.empty()) {
+        return 1.0;
+    }
+    
+    if (shingles1.empty() || shingles2.empty()) {
+        return 0.0;
+    }
+    
+    // Merge-count the intersection; the union follows from the sizes
+    size_t intersection = 0;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < shingles1.size() && j < shingles2.size()) {
+        if (shingles1[i] < shingles2[j]) {
+            ++i;
+        } else if (shingles2[j] < shingles1[i]) {
+            ++j;
+        } else {
+            ++intersection;
+            ++i;
+            ++j;
+        }
+    }
+    
+    size_t unionSize = shingles1.size() + shingles2.size() - intersection;
+    return static_cast<double>(intersection) / unionSize;
+}
+
+// Union sorted, deduplicated parts pairwise, one round at a time
+template <typename T>
+std::vector<T> mergeSortedParts(std::vector<std::vector<T>>& parts, Executor& executor) {
+    while (parts.size() > 1) {
+        std::vector<std::vector<T>> merged((parts.size() + 1) / 2);
+        executor.parallelFor(merged.size(), [&](size_t i) {
+            if (2 * i + 1 == parts.size()) {
+                merged[i] = std::move(parts[2 * i]);
+                return;
+            }
+            auto& first = parts[2 * i];
+            auto& second = parts[2 * i + 1];
+            merged[i].reserve(first.size() + second.size());
+            std::set_union(std::make_move_iterator(first.begin()), std::make_move_iterator(first.end()),
+                           std::make_move_iterator(second.begin()), std::make_move_iterator(second.end()),
+                           std::back_inserter(merged[i]));
+        });
+        parts = std::move(merged);
+    }
+    return parts.empty() ? std::vector<T>() : std::move(parts[0]);
+}
+
+} // namespace
+
+std::string ShinglingCalculator::normalizeText(std::string_view text) {
     std::string normalized;
-    for (char c : text) {
-        if (std::isalnum(c)) {
-            normalized += std::tolower(c);
-        } else if (std::isspace(c)) {
+    normalized.reserve(text.size());
+    std::string_view view(text);
+    
+    size_t pos = 0;
+    while (pos < view.size()) {
+        // Pure ASCII runs need no decoding
+        size_t end = pos + Utf8::asciiPrefixLength(view.substr(pos));
+        for (; pos < end; ++pos) {
+            char mapped = ASCII_NORMALIZE.map[static_cast<unsigned char>(view[pos])];
+            if (mapped) normalized += mapped;
+        }
+        if (pos == view.size()) break;
+        
+        char32_t cp = Utf8::decode(view, pos);
+        if (Utf8::isAlphanumeric(cp)) {
+            Utf8::encode(Utf8::foldCase(cp), normalized);
+        } else if (Utf8::isSpace(cp)) {
             normalized += ' ';
         }
     }
@@ -21,48 +126,202 @@ std::set<std::string> ShinglingCalculator::generateShingles(const std::string& t
 
 std::set<std::string> ShinglingCalculator::generateCharacterShingles(const std::string& text, int w) {
     std::set<std::string> shingles;
-    std::string normalized = normalizeText(text);
-    
-    if (normalized.length() < static_cast<size_t>(w)) {
-        shingles.insert(normalized);
-        return shingles;
-    }
-    
-    for (size_t i = 0; i <= normalized.length() - w; ++i) {
-        std::string shingle = normalized.substr(i, w);
-        // Skip shingles that are all spaces
-        if (shingle.find_first_not_of(' ') != std::string::npos) {
-            shingles.insert(shingle);
-        }
-    }
-    
+    forEachCharacterShingle(text, w, [&](std::string_view shingle) {
+        shingles.emplace(shingle);
+    });
     return shingles;
 }
 
 std::set<std::string> ShinglingCalculator::generateWordShingles(
     const std::vector<std::string>& tokens, int w) {
     std::set<std::string> shingles;
+    forEachWordShingle(tokens, w, [&](std::string_view shingle) {
+        shingles.emplace(shingle);
+    });
+    return shingles;
+}
+
+template <int W>
+void ShinglingCalculator::packAsciiShingles(std::string_view normalized, std::vector<uint64_t>& keys) {
+    constexpr uint64_t mask = W == 8 ? ~0ULL : ((1ULL << (8 * W)) - 1);
+    constexpr uint64_t spaces = 0x2020202020202020ULL & mask;
     
-    if (tokens.size() < static_cast<size_t>(w)) {
-        std::string shingle;
-        for (size_t i = 0; i < tokens.size(); ++i) {
-            if (i > 0) shingle += " ";
-            shingle += tokens[i];
+    // Slide a W-byte window through a shift register
+    uint64_t key = 0;
+    for (size_t i = 0; i < normalized.size(); ++i) {
+        key = ((key << 8) | static_cast<unsigned char>(normalized[i])) & mask;
+        if (i + 1 >= W && key != spaces) {
+            keys.push_back(key);
         }
-        shingles.insert(shingle);
-        return shingles;
+    }
+}
+
+void ShinglingCalculator::packGenericShingles(std::string_view normalized, int w,
+                                              std::vector<uint64_t>& keys) {
+    forEachCharacterShingleOf(normalized, w, [&](std::string_view shingle) {
+        keys.push_back(shingleKey(shingle, Utf8::isAscii(shingle), w));
+    });
+}
+
+std::vector<std::string> ShinglingCalculator::generateSortedWordShingles(
+    const std::vector<std::string>& tokens, int w) {
+    std::vector<std::string> shingles;
+    forEachWordShingle(tokens, w, [&](std::string_view shingle) {
+        shingles.emplace_back(shingle);
+    });
+    std::sort(shingles.begin(), shingles.end());
+    shingles.erase(std::unique(shingles.begin(), shingles.end()), shingles.end());
+    return shingles;
+}
+
+std::vector<std::string> ShinglingCalculator::generateSortedWordShingles(
+    const std::vector<std::string>& tokens, int w, Executor& executor, size_t chunkTokens) {
+    if (w < 1 || tokens.size() < static_cast<size_t>(w) + chunkTokens) {
+        return generateSortedWordShingles(tokens, w);
     }
     
-    for (size_t i = 0; i <= tokens.size() - w; ++i) {
-        std::string shingle;
-        for (int j = 0; j < w; ++j) {
-            if (j > 0) shingle += " ";
-            shingle += tokens[i + j];
+    // Ranges of shingle starts; the last shingle of a range reads w - 1
+    // tokens into the next one
+    const size_t count = tokens.size() - w + 1;
+    std::vector<std::vector<std::string>> parts((count + chunkTokens - 1) / chunkTokens);
+    executor.parallelFor(parts.size(), [&](size_t r) {
+        auto& shingles = parts[r];
+        size_t end = std::min(count, (r + 1) * chunkTokens);
+        for (size_t i = r * chunkTokens; i < end; ++i) {
+            std::string shingle = tokens[i];
+            for (int j = 1; j < w; ++j) {
+                shingle += " ";
+                shingle += tokens[i + j];
+            }
+            shingles.push_back(std::move(shingle));
         }
-        shingles.insert(shingle);
+        std::sort(shingles.begin(), shingles.end());
+        shingles.erase(std::unique(shingles.begin(), shingles.end()), shingles.end());
+    });
+    return mergeSortedParts(parts, executor);
+}
+
+std::vector<uint64_t> ShinglingCalculator::generateHashedWordShingles(
+    const std::vector<std::string>& tokens, int w) {
+    std::vector<uint64_t> keys;
+    forEachWordShingle(tokens, w, [&](std::string_view shingle) {
+        keys.push_back(hashBytes(shingle.data(), shingle.size()));
+    });
+    sortUnique(keys);
+    return keys;
+}
+
+void ShinglingCalculator::packShingles(std::string_view normalized, int w, bool ascii,
+                                       std::vector<uint64_t>& keys) {
+    if (!ascii || normalized.size() < static_cast<size_t>(w)) {
+        packGenericShingles(normalized, w, keys);
+        return;
+    }
+    keys.reserve(keys.size() + normalized.size());
+    switch (w) {
+        case 3: packAsciiShingles<3>(normalized, keys); break;
+        case 4: packAsciiShingles<4>(normalized, keys); break;
+        case 5: packAsciiShingles<5>(normalized, keys); break;
+        case 6: packAsciiShingles<6>(normalized, keys); break;
+        case 7: packAsciiShingles<7>(normalized, keys); break;
+        case 8: packAsciiShingles<8>(normalized, keys); break;
+        default: packGenericShingles(normalized, w, keys);
+    }
+}
+
+std::vector<uint64_t> ShinglingCalculator::generatePackedCharacterShingles(const std::string& text, int w) {
+    std::vector<uint64_t> keys;
+    std::string normalized = normalizeText(text);
+    packShingles(normalized, w, Utf8::isAscii(normalized), keys);
+    sortUnique(keys);
+    return keys;
+}
+
+std::vector<uint64_t> ShinglingCalculator::generatePackedCharacterShingles(const std::string& text, int w,
+                                                                          Executor& executor,
+                                                                          size_t chunkSize) {
+    std::string_view view(text);
+    std::vector<size_t> bounds = Utf8::chunkBoundaries(view, chunkSize);
+    const size_t pieces = bounds.size() - 1;
+    if (pieces == 1 || w < 1) return generatePackedCharacterShingles(text, w);
+    
+    // Normalization maps one code point at a time, so pieces normalize on their own
+    std::vector<std::string> normalizedPieces(pieces);
+    std::vector<char> asciiPieces(pieces);
+    executor.parallelFor(pieces, [&](size_t i) {
+        normalizedPieces[i] = normalizeText(view.substr(bounds[i], bounds[i + 1] - bounds[i]));
+        asciiPieces[i] = Utf8::isAscii(normalizedPieces[i]);
+    });
+    std::vector<size_t> starts(pieces + 1, 0);
+    for (size_t i = 0; i < pieces; ++i) starts[i + 1] = starts[i] + normalizedPieces[i].size();
+    std::string normalized(starts.back(), '\0');
+    executor.parallelFor(pieces, [&](size_t i) {
+        std::copy(normalizedPieces[i].begin(), normalizedPieces[i].end(), normalized.begin() + starts[i]);
+        std::string().swap(normalizedPieces[i]);
+    });
+    
+    // Key packing is chosen for the whole text, as in the serial path
+    bool ascii = std::all_of(asciiPieces.begin(), asciiPieces.end(), [](char flag) { return flag; });
+    std::string_view all(normalized);
+    std::vector<std::vector<uint64_t>> parts(pieces);
+    if (Utf8::codepointCount(all) < static_cast<size_t>(w)) {
+        packShingles(all, w, ascii, parts[0]);
+        sortUnique(parts[0]);
+        return std::move(parts[0]);
     }
     
-    return shingles;
+    // A piece's keys are the shingles starting in it, read from the piece
+    // plus the w - 1 code points after it
+    executor.parallelFor(pieces, [&](size_t i) {
+        size_t end = starts[i + 1];
+        for (int extra = 1; extra < w && end < all.size(); ++extra) {
+            do ++end; while (end < all.size() && (static_cast<unsigned char>(all[end]) & 0xC0) == 0x80);
+        }
+        std::string_view range = all.substr(starts[i], end - starts[i]);
+        if (Utf8::codepointCount(range) < static_cast<size_t>(w)) return; // no shingle starts here
+        packShingles(range, w, ascii, parts[i]);
+        sortUnique(parts[i]);
+    });
+    
+    return mergeSortedParts(parts, executor);
+}
+
+void ShinglingCalculator::sortUnique(std::vector<uint64_t>& keys) {
+    if (keys.size() < RADIX_MIN_SIZE) {
+        std::sort(keys.begin(), keys.end());
+    } else {
+        std::vector<uint64_t> buffer(keys.size());
+        for (int shift = 0; shift < 64; shift += 8) {
+            size_t counts[256] = {};
+            for (uint64_t key : keys) ++counts[(key >> shift) & 0xFF];
+            
+            // Bytes shared by every key (e.g. the zero high bytes of short
+            // packed shingles) do not need a pass
+            if (counts[(keys[0] >> shift) & 0xFF] == keys.size()) continue;
+            
+            size_t offset = 0;
+            for (size_t& count : counts) {
+                size_t c = count;
+                count = offset;
+                offset += c;
+            }
+            for (uint64_t key : keys) buffer[counts[(key >> shift) & 0xFF]++] = key;
+            keys.swap(buffer);
+        }
+    }
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+double ShinglingCalculator::calculateJaccardSimilarity(
+    const std::vector<uint64_t>& shingles1,
+    const std::vector<uint64_t>& shingles2) {
+    return sortedJaccard(shingles1, shingles2);
+}
+
+double ShinglingCalculator::calculateJaccardSimilarity(
+    const std::vector<std::string>& shingles1,
+    const std::vector<std::string>& shingles2) {
+    return sortedJaccard(shingles1, shingles2);
 }
 
 double ShinglingCalculator::calculateJaccardSimilarity(
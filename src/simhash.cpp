@@ -0,0 +1,134 @@
+#include "simhash.hpp"
+#include "hashing.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+void validateDistance(int maxDistance) {
+    if (maxDistance < 0 || maxDistance > 63) {
+        throw std::invalid_argument("Hamming distance must be between 0 and 63");
+    }
+}
+
+// Earlier tables already reported pairs that agree on one of their blocks
+bool reportedEarlier(uint64_t diff, const std::vector<uint64_t>& masks, size_t table) {
+    for (size_t t = 0; t < table; ++t) {
+        if ((diff & masks[t]) == 0) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+uint64_t SimHash::hashTerm(const std::string& term) {
+    return hashBytes(term.data(), term.size());
+}
+
+uint64_t SimHash::fingerprint(const std::unordered_map<std::string, double>& tf) {
+    double weights[64] = {};
+
+    for (const auto& [term, freq] : tf) {
+        uint64_t hash = hashTerm(term);
+        for (int bit = 0; bit < 64; ++bit) {
+            weights[bit] += ((hash >> bit) & 1) ? freq : -freq;
+        }
+    }
+
+    uint64_t result = 0;
+    for (int bit = 0; bit < 64; ++bit) {
+        if (weights[bit] > 0.0) {
+            result |= 1ULL << bit;
+        }
+    }
+    return result;
+}
+
+std::vector<NearDuplicate> SimHash::findNearDuplicates(
+    const std::vector<uint64_t>& fingerprints, int maxDistance) {
+    return SimHashIndex(fingerprints, maxDistance).pairs();
+}
+
+uint64_t SimHashIndex::blockMask(int b, int blockCount) {
+    int begin = 64 * b / blockCount;
+    int end = 64 * (b + 1) / blockCount;
+    int width = end - begin;
+    uint64_t bits = width == 64 ? ~0ULL : ((1ULL << width) - 1);
+    return bits << begin;
+}
+
+SimHashIndex::SimHashIndex(std::vector<uint64_t> fingerprints, int maxDistance)
+    : fingerprints(std::move(fingerprints)), maxDistance(maxDistance) {
+    validateDistance(maxDistance);
+
+    int blockCount = maxDistance + 1;
+    for (int b = 0; b < blockCount; ++b) {
+        uint64_t mask = blockMask(b, blockCount);
+        masks.push_back(mask);
+
+        std::vector<uint32_t> table(this->fingerprints.size());
+        for (size_t i = 0; i < table.size(); ++i) table[i] = static_cast<uint32_t>(i);
+        const auto& fps = this->fingerprints;
+        std::sort(table.begin(), table.end(), [&](uint32_t a, uint32_t c) {
+            uint64_t ka = fps[a] & mask;
+            uint64_t kc = fps[c] & mask;
+            return ka != kc ? ka < kc : a < c;
+        });
+        tables.push_back(std::move(table));
+    }
+}
+
+std::vector<std::pair<uint32_t, int>> SimHashIndex::query(uint64_t fingerprint) const {
+    std::vector<std::pair<uint32_t, int>> matches;
+
+    for (size_t t = 0; t < tables.size(); ++t) {
+        uint64_t mask = masks[t];
+        uint64_t key = fingerprint & mask;
+        const auto& table = tables[t];
+
+        auto it = std::lower_bound(table.begin(), table.end(), key,
+            [&](uint32_t id, uint64_t k) { return (fingerprints[id] & mask) < k; });
+        for (; it != table.end() && (fingerprints[*it] & mask) == key; ++it) {
+            uint64_t diff = fingerprints[*it] ^ fingerprint;
+            int distance = __builtin_popcountll(diff);
+            if (distance <= maxDistance && !reportedEarlier(diff, masks, t)) {
+                matches.emplace_back(*it, distance);
+            }
+        }
+    }
+
+    std::sort(matches.begin(), matches.end());
+    return matches;
+}
+
+std::vector<NearDuplicate> SimHashIndex::pairs() const {
+    std::vector<NearDuplicate> pairs;
+
+    for (size_t t = 0; t < tables.size(); ++t) {
+        uint64_t mask = masks[t];
+        const auto& table = tables[t];
+
+        // Compare documents within each run of equal block values
+        for (size_t start = 0; start < table.size();) {
+            uint64_t key = fingerprints[table[start]] & mask;
+            size_t end = start + 1;
+            while (end < table.size() && (fingerprints[table[end]] & mask) == key) ++end;
+
+            for (size_t a = start; a < end; ++a) {
+                for (size_t b = a + 1; b < end; ++b) {
+                    uint64_t diff = fingerprints[table[a]] ^ fingerprints[table[b]];
+                    int distance = __builtin_popcountll(diff);
+                    if (distance <= maxDistance && !reportedEarlier(diff, masks, t)) {
+                        pairs.push_back({table[a], table[b], distance});
+                    }
+                }
+            }
+            start = end;
+        }
+    }
+
+    std::sort(pairs.begin(), pairs.end(), [](const NearDuplicate& a, const NearDuplicate& b) {
+        return a.doc1 != b.doc1 ? a.doc1 < b.doc1 : a.doc2 < b.doc2;
+    });
+    return pairs;
+}
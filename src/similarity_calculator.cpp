@@ -1,5 +1,7 @@
 #include "similarity_calculator.hpp"
 #include <cmath>
+#include <algorithm>
+#include <stdexcept>
 
 double SimilarityCalculator::calculateCosineSimilarity(
     const std::unordered_map<std::string, double>& tf1,
@@ -27,6 +29,37 @@ double SimilarityCalculator::calculateCosineSimilarity(
     return dotProduct / (magnitude1 * magnitude2);
 }
 
+double SimilarityCalculator::calculateCosineSimilarity(const TermVector& v1, const TermVector& v2) {
+    // Both key lists are sorted, so shared terms are found by a merge
+    const size_t size1 = v1.keys.size();
+    const size_t size2 = v2.keys.size();
+    float dotProduct = 0.0f;
+    size_t i = 0, j = 0;
+    while (i < size1 && j < size2) {
+        uint32_t key1 = v1.keys[i];
+        uint32_t key2 = v2.keys[j];
+        if (key1 == key2) {
+            dotProduct += v1.weights[i++] * v2.weights[j++];
+        } else if (key1 < key2) {
+            ++i;
+        } else {
+            ++j;
+        }
+    }
+    
+    // Float rounding can push identical documents just past 1
+    return std::min(1.0, static_cast<double>(dotProduct));
+}
+
+double SimilarityCalculator::calculateCosineSimilarity(const HashedVector& v1, const HashedVector& v2) {
+    if (v1.values.size() != v2.values.size()) {
+        throw std::invalid_argument("Hashed vectors have different dimensions");
+    }
+    float dotProduct = VectorKernels::dot(v1.values.data(), v2.values.data(), v1.values.size());
+    // Colliding terms with opposite signs can pull the dot product below 0
+    return std::clamp(static_cast<double>(dotProduct), 0.0, 1.0);
+}
+
 double SimilarityCalculator::calculateTfIdfCosineSimilarity(
     const std::unordered_map<std::string, double>& tf1,
     const std::unordered_map<std::string, double>& tf2,
@@ -60,13 +93,24 @@ double SimilarityCalculator::calculateTfIdfCosineSimilarity(
 
 std::unordered_map<std::string, double> SimilarityCalculator::calculateIdf(
     const std::vector<std::unordered_map<std::string, double>>& documents
+) {
+    std::vector<const std::unordered_map<std::string, double>*> pointers;
+    pointers.reserve(documents.size());
+    for (const auto& doc : documents) {
+        pointers.push_back(&doc);
+    }
+    return calculateIdf(pointers);
+}
+
+std::unordered_map<std::string, double> SimilarityCalculator::calculateIdf(
+    const std::vector<const std::unordered_map<std::string, double>*>& documents
 ) {
     std::unordered_map<std::string, double> idf;
     std::unordered_map<std::string, int> documentFreq;
     
     // Count document frequency for each term
-    for (const auto& doc : documents) {
-        for (const auto& [term, freq] : doc) {
+    for (const auto* doc : documents) {
+        for (const auto& [term, freq] : *doc) {
             documentFreq[term]++;
         }
     }
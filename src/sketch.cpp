@@ -0,0 +1,278 @@
+#include "sketch.hpp"
+#include "hashing.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+const uint8_t SKETCH_VERSION = 1;
+const double Z_95 = 1.96;
+const uint64_t EMPTY_BIN = std::numeric_limits<uint64_t>::max();
+
+// Maps a 64-bit hash uniformly onto [0, range)
+uint32_t scaleHash(uint64_t hash, uint32_t range) {
+    return static_cast<uint32_t>((static_cast<unsigned __int128>(hash) * range) >> 64);
+}
+
+// Serialized sketches are little-endian on every host
+void appendUint32(std::string& out, uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        out += static_cast<char>((value >> shift) & 0xFF);
+    }
+}
+
+uint32_t readUint32(const std::string& data, size_t offset) {
+    uint32_t value = 0;
+    for (int k = 0; k < 4; ++k) {
+        value |= static_cast<uint32_t>(static_cast<uint8_t>(data[offset + k])) << (8 * k);
+    }
+    return value;
+}
+
+JaccardEstimate makeEstimate(double value, double standardError) {
+    JaccardEstimate estimate;
+    estimate.value = std::clamp(value, 0.0, 1.0);
+    estimate.lower = std::clamp(value - Z_95 * standardError, 0.0, 1.0);
+    estimate.upper = std::clamp(value + Z_95 * standardError, 0.0, 1.0);
+    return estimate;
+}
+
+} // namespace
+
+MinHashSketch::MinHashSketch(uint32_t bins, uint32_t bits)
+    : binCount(bins), bitCount(bits), minimums(bins, EMPTY_BIN) {
+    if (bins == 0) {
+        throw std::invalid_argument("MinHash sketch needs at least one bin");
+    }
+    if (bits == 0 || bits > 16) {
+        throw std::invalid_argument("MinHash sketch bits must be between 1 and 16");
+    }
+}
+
+MinHashSketch MinHashSketch::forError(double error, uint32_t bits) {
+    if (error <= 0.0 || error >= 1.0) {
+        throw std::invalid_argument("Sketch error target must be between 0 and 1");
+    }
+    // Worst case P(1-P) = 1/4; b-bit collisions inflate the error by 1/(1-2^-b)
+    double collision = std::ldexp(1.0, -static_cast<int>(bits));
+    double bins = std::ceil(std::pow(Z_95 * 0.5 / (error * (1.0 - collision)), 2.0));
+    return MinHashSketch(std::max<uint32_t>(16, static_cast<uint32_t>(bins)), bits);
+}
+
+void MinHashSketch::add(uint64_t hash) {
+    if (finalized) {
+        throw std::logic_error("Cannot add to a finalized MinHash sketch");
+    }
+    uint32_t bin = scaleHash(hash, binCount);
+    uint64_t value = mix64(hash ^ 0x9e3779b97f4a7c15ULL);
+    minimums[bin] = std::min(minimums[bin], value);
+    isEmpty = false;
+}
+
+void MinHashSketch::finalize() {
+    if (finalized) return;
+    finalized = true;
+
+    if (!isEmpty) {
+        // Optimal densification: an empty bin borrows from the first filled
+        // bin on its own deterministic probe sequence
+        std::vector<bool> filled(binCount);
+        for (uint32_t i = 0; i < binCount; ++i) filled[i] = minimums[i] != EMPTY_BIN;
+
+        for (uint32_t i = 0; i < binCount; ++i) {
+            if (filled[i]) continue;
+            for (uint64_t attempt = 1;; ++attempt) {
+                uint32_t donor = scaleHash(mix64((static_cast<uint64_t>(i) << 32) ^ attempt), binCount);
+                if (filled[donor]) {
+                    minimums[i] = minimums[donor];
+                    break;
+                }
+            }
+        }
+    }
+
+    packed.assign((static_cast<size_t>(binCount) * bitCount + 7) / 8, 0);
+    uint64_t mask = (1ULL << bitCount) - 1;
+    for (uint32_t i = 0; i < binCount; ++i) {
+        uint64_t value = isEmpty ? 0 : (minimums[i] & mask);
+        size_t bit = static_cast<size_t>(i) * bitCount;
+        for (uint32_t b = 0; b < bitCount; ++b, ++bit) {
+            if ((value >> b) & 1) packed[bit / 8] |= static_cast<uint8_t>(1u << (bit % 8));
+        }
+    }
+    minimums.clear();
+    minimums.shrink_to_fit();
+}
+
+uint32_t MinHashSketch::valueAt(uint32_t bin) const {
+    uint32_t value = 0;
+    size_t bit = static_cast<size_t>(bin) * bitCount;
+    for (uint32_t b = 0; b < bitCount; ++b, ++bit) {
+        value |= static_cast<uint32_t>((packed[bit / 8] >> (bit % 8)) & 1) << b;
+    }
+    return value;
+}
+
+JaccardEstimate MinHashSketch::estimateJaccard(const MinHashSketch& a, const MinHashSketch& b) {
+    if (!a.finalized || !b.finalized) {
+        throw std::logic_error("MinHash sketches must be finalized before comparison");
+    }
+    if (a.binCount != b.binCount || a.bitCount != b.bitCount) {
+        throw std::invalid_argument("MinHash sketches have different parameters");
+    }
+
+    // Same convention as ShinglingCalculator::calculateJaccardSimilarity
+    if (a.isEmpty && b.isEmpty) return makeEstimate(1.0, 0.0);
+    if (a.isEmpty || b.isEmpty) return makeEstimate(0.0, 0.0);
+
+    uint32_t matches = 0;
+    for (uint32_t i = 0; i < a.binCount; ++i) {
+        if (a.valueAt(i) == b.valueAt(i)) ++matches;
+    }
+
+    // Remove the chance that unrelated b-bit values collide
+    double collision = std::ldexp(1.0, -static_cast<int>(a.bitCount));
+    double p = static_cast<double>(matches) / a.binCount;
+    double jaccard = (p - collision) / (1.0 - collision);
+    double standardError = std::sqrt(p * (1.0 - p) / a.binCount) / (1.0 - collision);
+    return makeEstimate(jaccard, standardError);
+}
+
+std::string MinHashSketch::serialize() const {
+    if (!finalized) {
+        throw std::logic_error("MinHash sketch must be finalized before serializing");
+    }
+    std::string out = "MH";
+    out += static_cast<char>(SKETCH_VERSION);
+    out += static_cast<char>(bitCount);
+    out += static_cast<char>(isEmpty ? 1 : 0);
+    appendUint32(out, binCount);
+    out.append(reinterpret_cast<const char*>(packed.data()), packed.size());
+    return out;
+}
+
+MinHashSketch MinHashSketch::deserialize(const std::string& data) {
+    const size_t headerSize = 5 + sizeof(uint32_t);
+    if (data.size() < headerSize || data.compare(0, 2, "MH") != 0 ||
+        static_cast<uint8_t>(data[2]) != SKETCH_VERSION) {
+        throw std::invalid_argument("Not a serialized MinHash sketch");
+    }
+
+    // Check the length against the header before sizing anything from it
+    uint32_t bins = readUint32(data, 5);
+    uint32_t bits = static_cast<uint8_t>(data[3]);
+    size_t packedSize = (static_cast<size_t>(bins) * bits + 7) / 8;
+    if (data.size() != headerSize + packedSize) {
+        throw std::invalid_argument("Truncated MinHash sketch");
+    }
+
+    MinHashSketch sketch(bins, bits);
+    sketch.isEmpty = data[4] != 0;
+    sketch.finalized = true;
+    sketch.minimums.clear();
+    sketch.minimums.shrink_to_fit();
+    sketch.packed.assign(data.begin() + headerSize, data.end());
+    return sketch;
+}
+
+HyperLogLogSketch::HyperLogLogSketch(uint32_t precision) : precisionBits(precision) {
+    if (precision < 4 || precision > 18) {
+        throw std::invalid_argument("HyperLogLog precision must be between 4 and 18");
+    }
+    registers.assign(size_t(1) << precision, 0);
+}
+
+HyperLogLogSketch HyperLogLogSketch::forError(double error) {
+    if (error <= 0.0 || error >= 1.0) {
+        throw std::invalid_argument("Sketch error target must be between 0 and 1");
+    }
+    double registersNeeded = std::pow(1.04 / error, 2.0);
+    int precision = static_cast<int>(std::ceil(std::log2(registersNeeded)));
+    return HyperLogLogSketch(static_cast<uint32_t>(std::clamp(precision, 4, 18)));
+}
+
+void HyperLogLogSketch::add(uint64_t hash) {
+    size_t index = hash >> (64 - precisionBits);
+    // Guard bit keeps the rank bounded when the remaining bits are all zero
+    uint64_t rest = (hash << precisionBits) | (1ULL << (precisionBits - 1));
+    uint8_t rank = static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+    registers[index] = std::max(registers[index], rank);
+}
+
+void HyperLogLogSketch::merge(const HyperLogLogSketch& other) {
+    if (other.precisionBits != precisionBits) {
+        throw std::invalid_argument("HyperLogLog sketches have different precision");
+    }
+    for (size_t i = 0; i < registers.size(); ++i) {
+        registers[i] = std::max(registers[i], other.registers[i]);
+    }
+}
+
+double HyperLogLogSketch::cardinality() const {
+    double m = static_cast<double>(registers.size());
+    double alpha;
+    switch (registers.size()) {
+        case 16: alpha = 0.673; break;
+        case 32: alpha = 0.697; break;
+        case 64: alpha = 0.709; break;
+        default: alpha = 0.7213 / (1.0 + 1.079 / m);
+    }
+
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (uint8_t r : registers) {
+        sum += std::ldexp(1.0, -static_cast<int>(r));
+        if (r == 0) ++zeros;
+    }
+
+    double estimate = alpha * m * m / sum;
+    // Linear counting is more accurate for small cardinalities
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * std::log(m / static_cast<double>(zeros));
+    }
+    return estimate;
+}
+
+JaccardEstimate HyperLogLogSketch::estimateJaccard(const HyperLogLogSketch& a,
+                                                   const HyperLogLogSketch& b) {
+    HyperLogLogSketch unionSketch = a;
+    unionSketch.merge(b);
+
+    double sizeA = a.cardinality();
+    double sizeB = b.cardinality();
+    double sizeUnion = unionSketch.cardinality();
+    if (sizeUnion <= 0.0) return makeEstimate(1.0, 0.0);
+    if (sizeA <= 0.0 || sizeB <= 0.0) return makeEstimate(0.0, 0.0);
+
+    // Inclusion-exclusion; error propagated from the three cardinalities
+    double intersection = std::max(0.0, sizeA + sizeB - sizeUnion);
+    double relative = 1.04 / std::sqrt(static_cast<double>(a.registers.size()));
+    double standardError = relative *
+        std::sqrt(sizeA * sizeA + sizeB * sizeB + (sizeA + sizeB) * (sizeA + sizeB)) / sizeUnion;
+    return makeEstimate(intersection / sizeUnion, standardError);
+}
+
+std::string HyperLogLogSketch::serialize() const {
+    std::string out = "HL";
+    out += static_cast<char>(SKETCH_VERSION);
+    out += static_cast<char>(precisionBits);
+    out.append(reinterpret_cast<const char*>(registers.data()), registers.size());
+    return out;
+}
+
+HyperLogLogSketch HyperLogLogSketch::deserialize(const std::string& data) {
+    if (data.size() < 4 || data.compare(0, 2, "HL") != 0 ||
+        static_cast<uint8_t>(data[2]) != SKETCH_VERSION) {
+        throw std::invalid_argument("Not a serialized HyperLogLog sketch");
+    }
+
+    HyperLogLogSketch sketch(static_cast<uint8_t>(data[3]));
+    if (data.size() != 4 + sketch.registers.size()) {
+        throw std::invalid_argument("Truncated HyperLogLog sketch");
+    }
+    std::memcpy(sketch.registers.data(), data.data() + 4, sketch.registers.size());
+    return sketch;
+}
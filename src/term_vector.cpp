@@ -0,0 +1,190 @@
+#include "term_vector.hpp"
+#include "hashing.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMTEXT_HAVE_X86 1
+#endif
+
+namespace {
+
+// `missingSquares` adds weights of terms left out of `entries` to the norm
+TermVector buildNormalized(std::vector<std::pair<uint32_t, double>>& entries,
+                           double missingSquares = 0.0) {
+    std::sort(entries.begin(), entries.end());
+
+    double sumSquares = missingSquares;
+    for (const auto& entry : entries) sumSquares += entry.second * entry.second;
+
+    TermVector vector;
+    vector.norm = std::sqrt(sumSquares);
+    if (vector.norm == 0.0) {
+        return vector; // Cosine against a zero vector is 0
+    }
+
+    vector.keys.reserve(entries.size());
+    vector.weights.reserve(entries.size());
+    for (const auto& [key, weight] : entries) {
+        if (weight == 0.0) continue;
+        vector.keys.push_back(key);
+        vector.weights.push_back(static_cast<float>(weight / vector.norm));
+    }
+    return vector;
+}
+
+#ifdef SIMTEXT_HAVE_X86
+__attribute__((target("avx2,fma")))
+float dotAvx2(const float* a, const float* b, size_t size) {
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+        sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), sum1);
+    }
+    for (; i + 8 <= size; i += 8) {
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+    }
+
+    __m256 sum = _mm256_add_ps(sum0, sum1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    float result = _mm_cvtss_f32(half);
+
+    for (; i < size; ++i) result += a[i] * b[i];
+    return result;
+}
+#endif
+
+using DotKernel = float (*)(const float*, const float*, size_t);
+
+DotKernel selectKernel() {
+#ifdef SIMTEXT_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return dotAvx2;
+    }
+#endif
+    return VectorKernels::dotScalar;
+}
+
+const DotKernel DOT_KERNEL = selectKernel();
+
+} // namespace
+
+TermVector TermVector::fromTermFrequencies(const std::unordered_map<std::string, double>& tf,
+                                           Vocabulary& vocabulary) {
+    std::vector<std::pair<uint32_t, double>> entries;
+    entries.reserve(tf.size());
+    for (const auto& [term, freq] : tf) {
+        entries.emplace_back(vocabulary.intern(term), freq);
+    }
+    return buildNormalized(entries);
+}
+
+TermVector TermVector::fromTfIdf(const std::unordered_map<std::string, double>& tf,
+                                 const std::unordered_map<std::string, double>& idf,
+                                 Vocabulary& vocabulary) {
+    std::vector<std::pair<uint32_t, double>> entries;
+    entries.reserve(tf.size());
+    for (const auto& [term, freq] : tf) {
+        auto idfIt = idf.find(term);
+        if (idfIt != idf.end()) {
+            entries.emplace_back(vocabulary.intern(term), freq * idfIt->second);
+        }
+    }
+    return buildNormalized(entries);
+}
+
+TermVector TermVector::fromKnownTermFrequencies(const std::unordered_map<std::string, double>& tf,
+                                                const Vocabulary& vocabulary) {
+    std::vector<std::pair<uint32_t, double>> entries;
+    entries.reserve(tf.size());
+    double missingSquares = 0.0;
+    for (const auto& [term, freq] : tf) {
+        Vocabulary::TermId id;
+        if (vocabulary.find(term, id)) {
+            entries.emplace_back(id, freq);
+        } else {
+            missingSquares += freq * freq;
+        }
+    }
+    return buildNormalized(entries, missingSquares);
+}
+
+TermVector TermVector::fromKnownTfIdf(const std::unordered_map<std::string, double>& tf,
+                                      const std::unordered_map<std::string, double>& idf,
+                                      const Vocabulary& vocabulary) {
+    std::vector<std::pair<uint32_t, double>> entries;
+    entries.reserve(tf.size());
+    double missingSquares = 0.0;
+    for (const auto& [term, freq] : tf) {
+        auto idfIt = idf.find(term);
+        if (idfIt == idf.end()) continue;
+        double weight = freq * idfIt->second;
+        Vocabulary::TermId id;
+        if (vocabulary.find(term, id)) {
+            entries.emplace_back(id, weight);
+        } else {
+            missingSquares += weight * weight;
+        }
+    }
+    return buildNormalized(entries, missingSquares);
+}
+
+void TermVector::renumber(const std::vector<uint32_t>& ids) {
+    std::vector<std::pair<uint32_t, float>> entries(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        entries[i] = {ids.at(keys[i]), weights[i]};
+    }
+    std::sort(entries.begin(), entries.end());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        keys[i] = entries[i].first;
+        weights[i] = entries[i].second;
+    }
+}
+
+HashedVector HashedVector::fromTermFrequencies(const std::unordered_map<std::string, double>& tf,
+                                               size_t dimensions) {
+    if (dimensions == 0) {
+        throw std::invalid_argument("Hashed vectors need at least one dimension");
+    }
+
+    std::vector<double> accumulated(dimensions, 0.0);
+    for (const auto& [term, freq] : tf) {
+        uint64_t hash = hashBytes(term.data(), term.size());
+        size_t bucket = static_cast<size_t>((hash >> 1) % dimensions);
+        accumulated[bucket] += (hash & 1) ? freq : -freq;
+    }
+
+    double sumSquares = 0.0;
+    for (double value : accumulated) sumSquares += value * value;
+    double norm = std::sqrt(sumSquares);
+
+    HashedVector vector;
+    vector.values.assign(dimensions, 0.0f);
+    if (norm > 0.0) {
+        for (size_t i = 0; i < dimensions; ++i) {
+            vector.values[i] = static_cast<float>(accumulated[i] / norm);
+        }
+    }
+    return vector;
+}
+
+float VectorKernels::dotScalar(const float* a, const float* b, size_t size) {
+    float result = 0.0f;
+    for (size_t i = 0; i < size; ++i) result += a[i] * b[i];
+    return result;
+}
+
+float VectorKernels::dot(const float* a, const float* b, size_t size) {
+    return DOT_KERNEL(a, b, size);
+}
+
+const char* VectorKernels::activeKernel() {
+    return DOT_KERNEL == dotScalar ? "scalar" : "avx2-fma";
+}
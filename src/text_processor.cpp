@@ -1,9 +1,19 @@
 #include "text_processor.hpp"
+#include "utf8.hpp"
 #include <algorithm>
+#include <cstdint>
 #include <fstream>
-#include <sstream>
+#include <functional>
 #include <cctype>
 
+namespace {
+
+// Tokens counted per task, and hash partitions the counts are merged in
+constexpr size_t COUNT_RANGE = 1 << 16;
+constexpr size_t MERGE_PARTITIONS = 64;
+
+} // namespace
+
 TextProcessor::TextProcessor() : ignoreStopwords(false) {}
 
 void TextProcessor::loadStopwords(const std::string& filename) {
@@ -23,49 +33,102 @@ void TextProcessor::loadStopwords(const std::string& filename) {
 }
 
 std::string TextProcessor::toLowerCase(const std::string& text) const {
-    std::string result = text;
-    std::transform(result.begin(), result.end(), result.begin(), ::tolower);
-    return result;
+    return Utf8::toLowerCase(text);
 }
 
-std::vector<std::string> TextProcessor::tokenize(const std::string& text) const {
+std::vector<std::string> TextProcessor::tokenize(std::string_view text) const {
     std::vector<std::string> tokens;
-    std::istringstream iss(text);
-    std::string token;
+    std::string lowered = Utf8::toLowerCase(text);
+    std::string_view view(lowered);
     
-    while (iss >> token) {
+    auto addToken = [&](size_t begin, size_t end) {
         // Remove punctuation from beginning and end
-        token.erase(0, token.find_first_not_of(".,!?\"'();:"));
-        token.erase(token.find_last_not_of(".,!?\"'();:") + 1);
+        while (begin < end) {
+            size_t next = begin;
+            if (!Utf8::isPunctuation(Utf8::decode(view, next))) break;
+            begin = next;
+        }
+        while (end > begin) {
+            size_t last = end - 1;
+            while (last > begin && (static_cast<unsigned char>(view[last]) & 0xC0) == 0x80) --last;
+            size_t next = last;
+            if (!Utf8::isPunctuation(Utf8::decode(view, next))) break;
+            end = last;
+        }
         
-        if (!token.empty()) {
-            tokens.push_back(toLowerCase(token));
+        if (begin < end) {
+            tokens.emplace_back(view.substr(begin, end - begin));
         }
+    };
+    
+    // Split on Unicode whitespace
+    size_t tokenStart = std::string_view::npos;
+    size_t pos = 0;
+    while (pos < view.size()) {
+        size_t start = pos;
+        char32_t cp = Utf8::decode(view, pos);
+        if (Utf8::isSpace(cp)) {
+            if (tokenStart != std::string_view::npos) {
+                addToken(tokenStart, start);
+                tokenStart = std::string_view::npos;
+            }
+        } else if (tokenStart == std::string_view::npos) {
+            tokenStart = start;
+        }
+    }
+    if (tokenStart != std::string_view::npos) {
+        addToken(tokenStart, view.size());
     }
     
     return tokens;
 }
 
+void TextProcessor::removeStopwords(std::vector<std::string>& tokens) const {
+    if (!ignoreStopwords) return;
+    tokens.erase(
+        std::remove_if(tokens.begin(), tokens.end(),
+            [this](const std::string& token) {
+                return stopwords.find(token) != stopwords.end();
+            }
+        ),
+        tokens.end()
+    );
+}
+
 std::vector<std::string> TextProcessor::processText(const std::string& text) const {
     std::vector<std::string> tokens = tokenize(text);
-    
-    if (ignoreStopwords) {
-        tokens.erase(
-            std::remove_if(tokens.begin(), tokens.end(),
-                [this](const std::string& token) {
-                    return stopwords.find(token) != stopwords.end();
-                }
-            ),
-            tokens.end()
-        );
-    }
-    
+    removeStopwords(tokens);
+    return tokens;
+}
+
+std::vector<std::string> TextProcessor::processText(const std::string& text, Executor& executor,
+                                                    size_t chunkSize) const {
+    std::string_view view(text);
+    std::vector<size_t> bounds = Utf8::chunkBoundaries(view, chunkSize);
+    std::vector<std::vector<std::string>> pieces(bounds.size() - 1);
+    executor.parallelFor(pieces.size(), [&](size_t i) {
+        pieces[i] = tokenize(view.substr(bounds[i], bounds[i + 1] - bounds[i]));
+        removeStopwords(pieces[i]);
+    });
+
+    // Cuts follow whitespace, so every token lies within one piece
+    std::vector<size_t> offsets(pieces.size() + 1, 0);
+    for (size_t i = 0; i < pieces.size(); ++i) offsets[i + 1] = offsets[i] + pieces[i].size();
+    std::vector<std::string> tokens(offsets.back());
+    executor.parallelFor(pieces.size(), [&](size_t i) {
+        std::move(pieces[i].begin(), pieces[i].end(), tokens.begin() + offsets[i]);
+        std::vector<std::string>().swap(pieces[i]);
+    });
     return tokens;
 }
 
 std::unordered_map<std::string, double> TextProcessor::getTermFrequencyMap(
     const std::string& text) const {
-    std::vector<std::string> tokens = processText(text);
+    return getTermFrequencyMap(processText(text));
+}
+
+std::unordered_map<std::string, double> TextProcessor::getTermFrequencyMap(
+    const std::vector<std::string>& tokens) {
     std::unordered_map<std::string, double> tfMap;
     
     // Count occurrences of each token
@@ -80,4 +143,66 @@ std::unordered_map<std::string, double> TextProcessor::getTermFrequencyMap(
     }
     
     return tfMap;
-}
\ No newline at end of file
+}
+
+std::unordered_map<std::string, double> TextProcessor::getTermFrequencyMap(
+    const std::vector<std::string>& tokens, Executor& executor) {
+    if (tokens.size() <= COUNT_RANGE) return getTermFrequencyMap(tokens);
+
+    // Count each range of tokens, keeping its terms in first-occurrence
+    // order and noting which partition each belongs to
+    struct Range {
+        std::vector<std::pair<std::string_view, size_t>> terms;
+        std::vector<std::vector<uint32_t>> partitions; // indices into terms
+    };
+    std::vector<Range> ranges((tokens.size() + COUNT_RANGE - 1) / COUNT_RANGE);
+    executor.parallelFor(ranges.size(), [&](size_t r) {
+        Range& range = ranges[r];
+        std::unordered_map<std::string_view, uint32_t> positions;
+        size_t end = std::min(tokens.size(), (r + 1) * COUNT_RANGE);
+        for (size_t i = r * COUNT_RANGE; i < end; ++i) {
+            auto [it, inserted] = positions.try_emplace(tokens[i], static_cast<uint32_t>(range.terms.size()));
+            if (inserted) range.terms.emplace_back(tokens[i], 0);
+            ++range.terms[it->second].second;
+        }
+        range.partitions.resize(MERGE_PARTITIONS);
+        for (size_t i = 0; i < range.terms.size(); ++i) {
+            size_t partition = std::hash<std::string_view>()(range.terms[i].first) % MERGE_PARTITIONS;
+            range.partitions[partition].push_back(static_cast<uint32_t>(i));
+        }
+    });
+
+    // Sum each partition's counts across ranges; a term's first occurrence
+    // is the (range, position) it was first met at
+    struct Term {
+        uint64_t firstSeen;
+        std::string_view text;
+        size_t count;
+    };
+    std::vector<std::vector<Term>> partitions(MERGE_PARTITIONS);
+    executor.parallelFor(MERGE_PARTITIONS, [&](size_t p) {
+        std::unordered_map<std::string_view, size_t> positions;
+        for (size_t r = 0; r < ranges.size(); ++r) {
+            for (uint32_t i : ranges[r].partitions[p]) {
+                const auto& [text, count] = ranges[r].terms[i];
+                auto [it, inserted] = positions.try_emplace(text, partitions[p].size());
+                if (inserted) partitions[p].push_back({static_cast<uint64_t>(r) << 32 | i, text, 0});
+                partitions[p][it->second].count += count;
+            }
+        }
+    });
+
+    std::vector<Term> terms;
+    for (auto& partition : partitions) terms.insert(terms.end(), partition.begin(), partition.end());
+    std::sort(terms.begin(), terms.end(), [](const Term& a, const Term& b) { return a.firstSeen < b.firstSeen; });
+
+    std::unordered_map<std::string, double> tfMap;
+    for (const auto& term : terms) {
+        tfMap.emplace(term.text, static_cast<double>(term.count));
+    }
+    double totalTokens = tokens.size();
+    for (auto& pair : tfMap) {
+        pair.second /= totalTokens;
+    }
+    return tfMap;
+}
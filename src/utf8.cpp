@@ -0,0 +1,493 @@
+#include "utf8.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+enum CharFlags : uint8_t {
+    ALNUM = 1,
+    SPACE = 2,
+    PUNCT = 4
+};
+
+// Simple case folding: every CaseFolding.txt status C+S entry of Unicode 14.
+// Ranges are sorted and disjoint; stride 2 ranges list every other code point,
+// the upper case ones, with the lower case ones between them left unmapped.
+struct FoldRange {
+    char32_t first;
+    char32_t last;
+    int32_t delta;
+    uint8_t stride;
+};
+
+const FoldRange FOLD_RANGES[] = {
+    {0x0041, 0x005A, 32, 1},        // Basic Latin
+    {0x00B5, 0x00B5, 775, 1},       // Latin-1 Supplement (Micro sign -> Greek mu)
+    {0x00C0, 0x00D6, 32, 1},
+    {0x00D8, 0x00DE, 32, 1},
+    {0x0100, 0x012E, 1, 2},         // Latin Extended-A
+    {0x0132, 0x0136, 1, 2},
+    {0x0139, 0x0147, 1, 2},
+    {0x014A, 0x0176, 1, 2},
+    {0x0178, 0x0178, -121, 1},
+    {0x0179, 0x017D, 1, 2},
+    {0x017F, 0x017F, -268, 1},      // Long s
+    {0x0181, 0x0181, 210, 1},       // Latin Extended-B
+    {0x0182, 0x0184, 1, 2},
+    {0x0186, 0x0186, 206, 1},
+    {0x0187, 0x0187, 1, 1},
+    {0x0189, 0x018A, 205, 1},
+    {0x018B, 0x018B, 1, 1},
+    {0x018E, 0x018E, 79, 1},
+    {0x018F, 0x018F, 202, 1},
+    {0x0190, 0x0190, 203, 1},
+    {0x0191, 0x0191, 1, 1},
+    {0x0193, 0x0193, 205, 1},
+    {0x0194, 0x0194, 207, 1},
+    {0x0196, 0x0196, 211, 1},
+    {0x0197, 0x0197, 209, 1},
+    {0x0198, 0x0198, 1, 1},
+    {0x019C, 0x019C, 211, 1},
+    {0x019D, 0x019D, 213, 1},
+    {0x019F, 0x019F, 214, 1},
+    {0x01A0, 0x01A4, 1, 2},
+    {0x01A6, 0x01A6, 218, 1},
+    {0x01A7, 0x01A7, 1, 1},
+    {0x01A9, 0x01A9, 218, 1},
+    {0x01AC, 0x01AC, 1, 1},
+    {0x01AE, 0x01AE, 218, 1},
+    {0x01AF, 0x01AF, 1, 1},
+    {0x01B1, 0x01B2, 217, 1},
+    {0x01B3, 0x01B5, 1, 2},
+    {0x01B7, 0x01B7, 219, 1},
+    {0x01B8, 0x01B8, 1, 1},
+    {0x01BC, 0x01BC, 1, 1},
+    {0x01C4, 0x01C4, 2, 1},
+    {0x01C5, 0x01C5, 1, 1},
+    {0x01C7, 0x01C7, 2, 1},
+    {0x01C8, 0x01C8, 1, 1},
+    {0x01CA, 0x01CA, 2, 1},
+    {0x01CB, 0x01DB, 1, 2},
+    {0x01DE, 0x01EE, 1, 2},
+    {0x01F1, 0x01F1, 2, 1},
+    {0x01F2, 0x01F4, 1, 2},
+    {0x01F6, 0x01F6, -97, 1},
+    {0x01F7, 0x01F7, -56, 1},
+    {0x01F8, 0x021E, 1, 2},
+    {0x0220, 0x0220, -130, 1},
+    {0x0222, 0x0232, 1, 2},
+    {0x023A, 0x023A, 10795, 1},
+    {0x023B, 0x023B, 1, 1},
+    {0x023D, 0x023D, -163, 1},
+    {0x023E, 0x023E, 10792, 1},
+    {0x0241, 0x0241, 1, 1},
+    {0x0243, 0x0243, -195, 1},
+    {0x0244, 0x0244, 69, 1},
+    {0x0245, 0x0245, 71, 1},
+    {0x0246, 0x024E, 1, 2},
+    {0x0345, 0x0345, 116, 1},       // Combining Diacritical Marks (Ypogegrammeni -> iota)
+    {0x0370, 0x0372, 1, 2},         // Greek and Coptic
+    {0x0376, 0x0376, 1, 1},
+    {0x037F, 0x037F, 116, 1},
+    {0x0386, 0x0386, 38, 1},
+    {0x0388, 0x038A, 37, 1},
+    {0x038C, 0x038C, 64, 1},
+    {0x038E, 0x038F, 63, 1},
+    {0x0391, 0x03A1, 32, 1},
+    {0x03A3, 0x03AB, 32, 1},
+    {0x03C2, 0x03C2, 1, 1},         // Final sigma
+    {0x03CF, 0x03CF, 8, 1},
+    {0x03D0, 0x03D0, -30, 1},
+    {0x03D1, 0x03D1, -25, 1},
+    {0x03D5, 0x03D5, -15, 1},
+    {0x03D6, 0x03D6, -22, 1},
+    {0x03D8, 0x03EE, 1, 2},
+    {0x03F0, 0x03F0, -54, 1},
+    {0x03F1, 0x03F1, -48, 1},
+    {0x03F4, 0x03F4, -60, 1},
+    {0x03F5, 0x03F5, -64, 1},
+    {0x03F7, 0x03F7, 1, 1},
+    {0x03F9, 0x03F9, -7, 1},
+    {0x03FA, 0x03FA, 1, 1},
+    {0x03FD, 0x03FF, -130, 1},
+    {0x0400, 0x040F, 80, 1},        // Cyrillic
+    {0x0410, 0x042F, 32, 1},
+    {0x0460, 0x0480, 1, 2},
+    {0x048A, 0x04BE, 1, 2},
+    {0x04C0, 0x04C0, 15, 1},
+    {0x04C1, 0x04CD, 1, 2},
+    {0x04D0, 0x052E, 1, 2},
+    {0x0531, 0x0556, 48, 1},        // Armenian
+    {0x10A0, 0x10C5, 7264, 1},      // Georgian
+    {0x10C7, 0x10C7, 7264, 1},
+    {0x10CD, 0x10CD, 7264, 1},
+    {0x13F8, 0x13FD, -8, 1},        // Cherokee
+    {0x1C80, 0x1C80, -6222, 1},     // Cyrillic Extended-C
+    {0x1C81, 0x1C81, -6221, 1},
+    {0x1C82, 0x1C82, -6212, 1},
+    {0x1C83, 0x1C84, -6210, 1},
+    {0x1C85, 0x1C85, -6211, 1},
+    {0x1C86, 0x1C86, -6204, 1},
+    {0x1C87, 0x1C87, -6180, 1},
+    {0x1C88, 0x1C88, 35267, 1},
+    {0x1C90, 0x1CBA, -3008, 1},     // Georgian Extended
+    {0x1CBD, 0x1CBF, -3008, 1},
+    {0x1E00, 0x1E94, 1, 2},         // Latin Extended Additional
+    {0x1E9B, 0x1E9B, -58, 1},
+    {0x1E9E, 0x1E9E, -7615, 1},     // Capital sharp s
+    {0x1EA0, 0x1EFE, 1, 2},
+    {0x1F08, 0x1F0F, -8, 1},        // Greek Extended
+    {0x1F18, 0x1F1D, -8, 1},
+    {0x1F28, 0x1F2F, -8, 1},
+    {0x1F38, 0x1F3F, -8, 1},
+    {0x1F48, 0x1F4D, -8, 1},
+    {0x1F59, 0x1F5F, -8, 2},
+    {0x1F68, 0x1F6F, -8, 1},
+    {0x1F88, 0x1F8F, -8, 1},
+    {0x1F98, 0x1F9F, -8, 1},
+    {0x1FA8, 0x1FAF, -8, 1},
+    {0x1FB8, 0x1FB9, -8, 1},
+    {0x1FBA, 0x1FBB, -74, 1},
+    {0x1FBC, 0x1FBC, -9, 1},
+    {0x1FBE, 0x1FBE, -7173, 1},
+    {0x1FC8, 0x1FCB, -86, 1},
+    {0x1FCC, 0x1FCC, -9, 1},
+    {0x1FD8, 0x1FD9, -8, 1},
+    {0x1FDA, 0x1FDB, -100, 1},
+    {0x1FE8, 0x1FE9, -8, 1},
+    {0x1FEA, 0x1FEB, -112, 1},
+    {0x1FEC, 0x1FEC, -7, 1},
+    {0x1FF8, 0x1FF9, -128, 1},
+    {0x1FFA, 0x1FFB, -126, 1},
+    {0x1FFC, 0x1FFC, -9, 1},
+    {0x2126, 0x2126, -7517, 1},     // Letterlike Symbols
+    {0x212A, 0x212A, -8383, 1},
+    {0x212B, 0x212B, -8262, 1},
+    {0x2132, 0x2132, 28, 1},
+    {0x2160, 0x216F, 16, 1},        // Number Forms
+    {0x2183, 0x2183, 1, 1},
+    {0x24B6, 0x24CF, 26, 1},        // Enclosed Alphanumerics
+    {0x2C00, 0x2C2F, 48, 1},        // Glagolitic
+    {0x2C60, 0x2C60, 1, 1},         // Latin Extended-C
+    {0x2C62, 0x2C62, -10743, 1},
+    {0x2C63, 0x2C63, -3814, 1},
+    {0x2C64, 0x2C64, -10727, 1},
+    {0x2C67, 0x2C6B, 1, 2},
+    {0x2C6D, 0x2C6D, -10780, 1},
+    {0x2C6E, 0x2C6E, -10749, 1},
+    {0x2C6F, 0x2C6F, -10783, 1},
+    {0x2C70, 0x2C70, -10782, 1},
+    {0x2C72, 0x2C72, 1, 1},
+    {0x2C75, 0x2C75, 1, 1},
+    {0x2C7E, 0x2C7F, -10815, 1},
+    {0x2C80, 0x2CE2, 1, 2},         // Coptic
+    {0x2CEB, 0x2CED, 1, 2},
+    {0x2CF2, 0x2CF2, 1, 1},
+    {0xA640, 0xA66C, 1, 2},         // Cyrillic Extended-B
+    {0xA680, 0xA69A, 1, 2},
+    {0xA722, 0xA72E, 1, 2},         // Latin Extended-D
+    {0xA732, 0xA76E, 1, 2},
+    {0xA779, 0xA77B, 1, 2},
+    {0xA77D, 0xA77D, -35332, 1},
+    {0xA77E, 0xA786, 1, 2},
+    {0xA78B, 0xA78B, 1, 1},
+    {0xA78D, 0xA78D, -42280, 1},
+    {0xA790, 0xA792, 1, 2},
+    {0xA796, 0xA7A8, 1, 2},
+    {0xA7AA, 0xA7AA, -42308, 1},
+    {0xA7AB, 0xA7AB, -42319, 1},
+    {0xA7AC, 0xA7AC, -42315, 1},
+    {0xA7AD, 0xA7AD, -42305, 1},
+    {0xA7AE, 0xA7AE, -42308, 1},
+    {0xA7B0, 0xA7B0, -42258, 1},
+    {0xA7B1, 0xA7B1, -42282, 1},
+    {0xA7B2, 0xA7B2, -42261, 1},
+    {0xA7B3, 0xA7B3, 928, 1},
+    {0xA7B4, 0xA7C2, 1, 2},
+    {0xA7C4, 0xA7C4, -48, 1},
+    {0xA7C5, 0xA7C5, -42307, 1},
+    {0xA7C6, 0xA7C6, -35384, 1},
+    {0xA7C7, 0xA7C9, 1, 2},
+    {0xA7D0, 0xA7D0, 1, 1},
+    {0xA7D6, 0xA7D8, 1, 2},
+    {0xA7F5, 0xA7F5, 1, 1},
+    {0xAB70, 0xABBF, -38864, 1},    // Cherokee Supplement
+    {0xFF21, 0xFF3A, 32, 1},        // Fullwidth Latin
+    {0x010400, 0x010427, 40, 1},    // Deseret
+    {0x0104B0, 0x0104D3, 40, 1},    // Osage
+    {0x010570, 0x01057A, 39, 1},    // Vithkuqi
+    {0x01057C, 0x01058A, 39, 1},
+    {0x01058C, 0x010592, 39, 1},
+    {0x010594, 0x010595, 39, 1},
+    {0x010C80, 0x010CB2, 64, 1},    // Old Hungarian
+    {0x0118A0, 0x0118BF, 32, 1},    // Warang Citi
+    {0x016E40, 0x016E5F, 32, 1},    // Medefaidrin
+    {0x01E900, 0x01E921, 34, 1},    // Adlam
+};
+
+struct ClassRange {
+    char32_t first;
+    char32_t last;
+    uint8_t flags;
+};
+
+const ClassRange CLASS_RANGES[] = {
+    // Whitespace, matching std::isspace in the C locale plus Unicode spaces
+    {0x0009, 0x000D, SPACE}, {0x0020, 0x0020, SPACE}, {0x0085, 0x0085, SPACE},
+    {0x00A0, 0x00A0, SPACE}, {0x1680, 0x1680, SPACE}, {0x2000, 0x200A, SPACE},
+    {0x2028, 0x2029, SPACE}, {0x202F, 0x202F, SPACE}, {0x205F, 0x205F, SPACE},
+    {0x3000, 0x3000, SPACE},
+
+    // Punctuation stripped from token edges
+    {0x0021, 0x0022, PUNCT}, {0x0027, 0x0029, PUNCT}, {0x002C, 0x002C, PUNCT},
+    {0x002E, 0x002E, PUNCT}, {0x003A, 0x003B, PUNCT}, {0x003F, 0x003F, PUNCT},
+    {0x00A1, 0x00A1, PUNCT}, {0x00AB, 0x00AB, PUNCT}, {0x00BB, 0x00BB, PUNCT},
+    {0x00BF, 0x00BF, PUNCT}, {0x2018, 0x201F, PUNCT}, {0x2026, 0x2026, PUNCT},
+    {0x3001, 0x3002, PUNCT}, {0x300C, 0x300F, PUNCT}, {0xFF01, 0xFF01, PUNCT},
+    {0xFF08, 0xFF09, PUNCT}, {0xFF0C, 0xFF0C, PUNCT}, {0xFF0E, 0xFF0E, PUNCT},
+    {0xFF1A, 0xFF1B, PUNCT}, {0xFF1F, 0xFF1F, PUNCT},
+
+    // Letters, digits and combining marks
+    {0x0030, 0x0039, ALNUM}, {0x0041, 0x005A, ALNUM}, {0x0061, 0x007A, ALNUM},
+    {0x00AA, 0x00AA, ALNUM}, {0x00B5, 0x00B5, ALNUM}, {0x00BA, 0x00BA, ALNUM},
+    {0x00C0, 0x00D6, ALNUM}, {0x00D8, 0x00F6, ALNUM}, {0x00F8, 0x02C1, ALNUM},
+    {0x0300, 0x0374, ALNUM}, {0x0376, 0x037D, ALNUM}, {0x0386, 0x0386, ALNUM},
+    {0x0388, 0x03FF, ALNUM}, {0x0400, 0x0481, ALNUM}, {0x0483, 0x052F, ALNUM},
+    {0x0531, 0x0556, ALNUM}, {0x0561, 0x0587, ALNUM}, {0x0591, 0x05C7, ALNUM},
+    {0x05D0, 0x05EA, ALNUM}, {0x0610, 0x061A, ALNUM}, {0x0620, 0x0669, ALNUM},
+    {0x066E, 0x06D3, ALNUM}, {0x06D5, 0x06DC, ALNUM}, {0x06F0, 0x06FF, ALNUM},
+    {0x0900, 0x0963, ALNUM}, {0x0966, 0x096F, ALNUM}, {0x0980, 0x09FF, ALNUM},
+    {0x0E01, 0x0E3A, ALNUM}, {0x0E40, 0x0E4E, ALNUM}, {0x0E50, 0x0E59, ALNUM},
+    {0x10A0, 0x10FF, ALNUM}, {0x1100, 0x11FF, ALNUM}, {0x1E00, 0x1FBC, ALNUM},
+    {0x2160, 0x2188, ALNUM}, {0x24B6, 0x24E9, ALNUM}, {0x2C00, 0x2C5F, ALNUM},
+    {0x3041, 0x3096, ALNUM}, {0x3099, 0x309F, ALNUM}, {0x30A1, 0x30FA, ALNUM},
+    {0x30FC, 0x30FF, ALNUM}, {0x3131, 0x318E, ALNUM}, {0x3400, 0x4DBF, ALNUM},
+    {0x4E00, 0x9FFF, ALNUM}, {0xAC00, 0xD7A3, ALNUM}, {0xF900, 0xFAFF, ALNUM},
+    {0xFF10, 0xFF19, ALNUM}, {0xFF21, 0xFF3A, ALNUM}, {0xFF41, 0xFF5A, ALNUM},
+    {0xFF66, 0xFF9F, ALNUM}, {0x10400, 0x1044F, ALNUM}, {0x20000, 0x2FA1F, ALNUM},
+};
+
+const char32_t REPLACEMENT = 0xFFFD;
+const char32_t BMP_END = 0x10000;
+
+struct Page {
+    int32_t delta[256];
+    uint8_t flags[256];
+
+    bool operator==(const Page& other) const {
+        return std::memcmp(delta, other.delta, sizeof(delta)) == 0 &&
+               std::memcmp(flags, other.flags, sizeof(flags)) == 0;
+    }
+};
+
+int32_t rangeDelta(char32_t cp) {
+    // The only candidate is the first range ending at or after cp
+    auto range = std::lower_bound(std::begin(FOLD_RANGES), std::end(FOLD_RANGES), cp,
+                                  [](const FoldRange& r, char32_t value) { return r.last < value; });
+    if (range == std::end(FOLD_RANGES) || cp < range->first ||
+        (cp - range->first) % range->stride != 0) {
+        return 0;
+    }
+    return range->delta;
+}
+
+uint8_t rangeFlags(char32_t cp) {
+    uint8_t flags = 0;
+    for (const auto& range : CLASS_RANGES) {
+        if (cp >= range.first && cp <= range.last) flags |= range.flags;
+    }
+    return flags;
+}
+
+// Two-stage lookup for the BMP. Most pages (CJK, Hangul, unassigned) are
+// identical and shared, so the tables stay a few dozen kilobytes.
+struct Tables {
+    uint16_t stage1[256];
+    std::vector<Page> pages;
+
+    Tables() {
+        for (char32_t high = 0; high < 256; ++high) {
+            Page page;
+            for (char32_t low = 0; low < 256; ++low) {
+                char32_t cp = (high << 8) | low;
+                page.delta[low] = rangeDelta(cp);
+                page.flags[low] = rangeFlags(cp);
+            }
+            auto it = std::find(pages.begin(), pages.end(), page);
+            stage1[high] = static_cast<uint16_t>(it - pages.begin());
+            if (it == pages.end()) pages.push_back(page);
+        }
+    }
+
+    const Page& page(char32_t cp) const { return pages[stage1[cp >> 8]]; }
+};
+
+const Tables& tables() {
+    static const Tables instance;
+    return instance;
+}
+
+uint8_t flagsOf(char32_t cp) {
+    if (cp < BMP_END) return tables().page(cp).flags[cp & 0xFF];
+    return rangeFlags(cp);
+}
+
+} // namespace
+
+char32_t Utf8::decode(std::string_view text, size_t& pos) {
+    unsigned char lead = static_cast<unsigned char>(text[pos]);
+    if (lead < 0x80) {
+        ++pos;
+        return lead;
+    }
+
+    size_t length;
+    char32_t cp;
+    char32_t minimum;
+    if ((lead & 0xE0) == 0xC0) { length = 2; cp = lead & 0x1F; minimum = 0x80; }
+    else if ((lead & 0xF0) == 0xE0) { length = 3; cp = lead & 0x0F; minimum = 0x800; }
+    else if ((lead & 0xF8) == 0xF0) { length = 4; cp = lead & 0x07; minimum = 0x10000; }
+    else { ++pos; return REPLACEMENT; }
+
+    if (pos + length > text.size()) {
+        ++pos;
+        return REPLACEMENT;
+    }
+    for (size_t i = 1; i < length; ++i) {
+        unsigned char next = static_cast<unsigned char>(text[pos + i]);
+        if ((next & 0xC0) != 0x80) {
+            ++pos;
+            return REPLACEMENT;
+        }
+        cp = (cp << 6) | (next & 0x3F);
+    }
+
+    // Reject overlong forms, surrogates and values past U+10FFFF
+    if (cp < minimum || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+        ++pos;
+        return REPLACEMENT;
+    }
+    pos += length;
+    return cp;
+}
+
+void Utf8::encode(char32_t cp, std::string& out) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+char32_t Utf8::foldCase(char32_t cp) {
+    if (cp < BMP_END) return cp + tables().page(cp).delta[cp & 0xFF];
+    return cp + rangeDelta(cp);
+}
+
+bool Utf8::isAlphanumeric(char32_t cp) {
+    return flagsOf(cp) & ALNUM;
+}
+
+bool Utf8::isSpace(char32_t cp) {
+    return flagsOf(cp) & SPACE;
+}
+
+bool Utf8::isPunctuation(char32_t cp) {
+    return flagsOf(cp) & PUNCT;
+}
+
+size_t Utf8::asciiPrefixLength(std::string_view text) {
+    const char* data = text.data();
+    size_t size = text.size();
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    for (; i + 16 <= size; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        int mask = _mm_movemask_epi8(block);
+        if (mask != 0) return i + __builtin_ctz(static_cast<unsigned>(mask));
+    }
+#else
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        if (word & 0x8080808080808080ULL) break;
+    }
+#endif
+
+    while (i < size && static_cast<unsigned char>(data[i]) < 0x80) ++i;
+    return i;
+}
+
+size_t Utf8::codepointCount(std::string_view text) {
+    size_t count = 0;
+    for (char c : text) {
+        if ((static_cast<unsigned char>(c) & 0xC0) != 0x80) ++count;
+    }
+    return count;
+}
+
+std::string Utf8::toLowerCase(std::string_view text) {
+    std::string result;
+    result.reserve(text.size());
+
+    size_t pos = 0;
+    while (pos < text.size()) {
+        // ASCII run: lowercase 16 bytes per step
+        size_t end = pos + asciiPrefixLength(text.substr(pos));
+        size_t start = result.size();
+        result.append(text.data() + pos, end - pos);
+        char* out = &result[0] + start;
+        size_t length = end - pos;
+        size_t i = 0;
+#if defined(__SSE2__)
+        const __m128i beforeA = _mm_set1_epi8('A' - 1);
+        const __m128i afterZ = _mm_set1_epi8('Z' + 1);
+        const __m128i caseBit = _mm_set1_epi8(0x20);
+        for (; i + 16 <= length; i += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out + i));
+            __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(block, beforeA), _mm_cmplt_epi8(block, afterZ));
+            block = _mm_or_si128(block, _mm_and_si128(upper, caseBit));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), block);
+        }
+#endif
+        for (; i < length; ++i) {
+            if (out[i] >= 'A' && out[i] <= 'Z') out[i] = static_cast<char>(out[i] + 32);
+        }
+        pos = end;
+
+        if (pos < text.size()) {
+            encode(foldCase(decode(text, pos)), result);
+        }
+    }
+    return result;
+}
+
+std::vector<size_t> Utf8::chunkBoundaries(std::string_view text, size_t chunkSize) {
+    std::vector<size_t> bounds{0};
+    size_t position = std::max<size_t>(chunkSize, 1);
+    while (position < text.size()) {
+        size_t space = text.find_first_of(" \t\n\r", position - 1);
+        if (space == std::string_view::npos || space + 1 >= text.size()) break;
+        bounds.push_back(space + 1);
+        position = space + 1 + std::max<size_t>(chunkSize, 1);
+    }
+    bounds.push_back(text.size());
+    return bounds;
+}
@@ -0,0 +1,207 @@
+#include "vocabulary.hpp"
+#include "hashing.hpp"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t FIRST_SEGMENT_BITS = 10;
+constexpr size_t ARENA_BLOCK = 64 * 1024;
+
+uint32_t hashTag(uint64_t hash) {
+    return static_cast<uint32_t>(hash >> 24);
+}
+
+uint64_t slotValue(uint64_t hash, uint32_t id) {
+    return static_cast<uint64_t>(hashTag(hash)) << 32 | (static_cast<uint64_t>(id) + 1);
+}
+
+// Segment and offset of an id: segment k holds 1024 << k entries
+std::pair<size_t, size_t> segmentOf(uint32_t id) {
+    uint64_t shifted = static_cast<uint64_t>(id) + (1u << FIRST_SEGMENT_BITS);
+    size_t bit = 63 - static_cast<size_t>(__builtin_clzll(shifted));
+    return {bit - FIRST_SEGMENT_BITS, shifted - (uint64_t(1) << bit)};
+}
+
+} // namespace
+
+Vocabulary::Table::Table(size_t capacity)
+    : mask(capacity - 1), slots(new std::atomic<uint64_t>[capacity]) {
+    for (size_t i = 0; i < capacity; ++i) slots[i].store(0, std::memory_order_relaxed);
+}
+
+Vocabulary::Vocabulary(size_t expectedTerms) : shards(new Shard[size_t(1) << SHARD_BITS]) {
+    // Start each shard at about half full for the expected terms
+    size_t perShard = expectedTerms >> SHARD_BITS;
+    size_t capacity = 16;
+    while (capacity < perShard * 2) capacity *= 2;
+    for (size_t i = 0; i < (size_t(1) << SHARD_BITS); ++i) {
+        shards[i].tables.push_back(std::make_unique<Table>(capacity));
+        shards[i].table.store(shards[i].tables.back().get(), std::memory_order_release);
+    }
+}
+
+Vocabulary::~Vocabulary() {
+    for (auto& segment : segments) delete[] segment.load();
+}
+
+Vocabulary::Entry& Vocabulary::entry(TermId id) {
+    auto [segment, offset] = segmentOf(id);
+    Entry* entries = segments[segment].load(std::memory_order_acquire);
+    if (!entries) {
+        Entry* fresh = new Entry[size_t(1) << (segment + FIRST_SEGMENT_BITS)];
+        if (segments[segment].compare_exchange_strong(entries, fresh, std::memory_order_acq_rel)) {
+            entries = fresh;
+        } else {
+            delete[] fresh; // another shard allocated it first
+        }
+    }
+    return entries[offset];
+}
+
+const Vocabulary::Entry& Vocabulary::entry(TermId id) const {
+    auto [segment, offset] = segmentOf(id);
+    return segments[segment].load(std::memory_order_acquire)[offset];
+}
+
+bool Vocabulary::findIn(const Table& table, std::string_view term, uint64_t hash, TermId& id) const {
+    uint32_t tag = hashTag(hash);
+    for (size_t position = hash & table.mask;; position = (position + 1) & table.mask) {
+        uint64_t slot = table.slots[position].load(std::memory_order_acquire);
+        if (slot == 0) return false;
+        if (static_cast<uint32_t>(slot >> 32) != tag) continue;
+
+        TermId candidate = static_cast<TermId>(slot) - 1;
+        const Entry& stored = entry(candidate);
+        if (stored.length == term.size() && std::memcmp(stored.data, term.data(), term.size()) == 0) {
+            id = candidate;
+            return true;
+        }
+    }
+}
+
+void Vocabulary::insertSlot(Table& table, uint64_t hash, TermId id) {
+    size_t position = hash & table.mask;
+    while (table.slots[position].load(std::memory_order_relaxed) != 0) {
+        position = (position + 1) & table.mask;
+    }
+    // Publishes the entry written before it to lock-free readers
+    table.slots[position].store(slotValue(hash, id), std::memory_order_release);
+    ++table.used;
+}
+
+const char* Vocabulary::storeBytes(Shard& shard, std::string_view term) {
+    if (term.size() > ARENA_BLOCK / 4) {
+        // Long terms get a block of their own instead of wasting the current one
+        char* bytes = new char[term.size()];
+        shard.blocks.emplace_back(bytes);
+        if (shard.blocks.size() > 1 && shard.blockSize > 0) {
+            std::swap(shard.blocks[shard.blocks.size() - 1], shard.blocks[shard.blocks.size() - 2]);
+        }
+        std::memcpy(bytes, term.data(), term.size());
+        return bytes;
+    }
+    if (shard.blocks.empty() || shard.blockUsed + term.size() > shard.blockSize) {
+        shard.blocks.emplace_back(new char[ARENA_BLOCK]);
+        shard.blockUsed = 0;
+        shard.blockSize = ARENA_BLOCK;
+    }
+    char* bytes = shard.blocks.back().get() + shard.blockUsed;
+    std::memcpy(bytes, term.data(), term.size());
+    shard.blockUsed += term.size();
+    return bytes;
+}
+
+Vocabulary::TermId Vocabulary::intern(std::string_view term) {
+    uint64_t hash = hashBytes(term.data(), term.size());
+    Shard& shard = shards[hash >> (64 - SHARD_BITS)];
+
+    // Almost every token is a repeat, found without locking
+    TermId id;
+    if (findIn(*shard.table.load(std::memory_order_acquire), term, hash, id)) return id;
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Table* table = shard.table.load(std::memory_order_relaxed);
+    if (findIn(*table, term, hash, id)) return id;
+
+    if (term.size() > UINT32_MAX) {
+        throw std::length_error("Term too long for the vocabulary");
+    }
+    id = nextId.load(std::memory_order_relaxed);
+    do {
+        if (id == UINT32_MAX) throw std::length_error("Vocabulary is full");
+    } while (!nextId.compare_exchange_weak(id, id + 1, std::memory_order_acq_rel));
+
+    Entry& stored = entry(id);
+    stored.data = storeBytes(shard, term);
+    stored.length = static_cast<uint32_t>(term.size());
+
+    if ((table->used + 1) * 2 > table->mask + 1) {
+        // Readers may still be probing the old table, so it is kept until
+        // finalize(); a miss there just sends them to this locked path
+        auto grown = std::make_unique<Table>((table->mask + 1) * 2);
+        for (size_t i = 0; i <= table->mask; ++i) {
+            uint64_t slot = table->slots[i].load(std::memory_order_relaxed);
+            if (slot == 0) continue;
+            const Entry& existing = entry(static_cast<TermId>(slot) - 1);
+            insertSlot(*grown, hashBytes(existing.data, existing.length), static_cast<TermId>(slot) - 1);
+        }
+        table = grown.get();
+        shard.tables.push_back(std::move(grown));
+        insertSlot(*table, hash, id);
+        shard.table.store(table, std::memory_order_release);
+    } else {
+        insertSlot(*table, hash, id);
+    }
+    return id;
+}
+
+bool Vocabulary::find(std::string_view term, TermId& id) const {
+    uint64_t hash = hashBytes(term.data(), term.size());
+    const Shard& shard = shards[hash >> (64 - SHARD_BITS)];
+    return findIn(*shard.table.load(std::memory_order_acquire), term, hash, id);
+}
+
+std::string_view Vocabulary::term(TermId id) const {
+    const Entry& stored = entry(id);
+    return std::string_view(stored.data, stored.length);
+}
+
+std::vector<Vocabulary::TermId> Vocabulary::finalize() {
+    const size_t count = size();
+    std::vector<TermId> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](TermId a, TermId b) { return term(a) < term(b); });
+
+    std::vector<TermId> renumbered(count);
+    std::vector<Entry> entries(count);
+    for (size_t rank = 0; rank < count; ++rank) {
+        renumbered[order[rank]] = static_cast<TermId>(rank);
+        entries[rank] = entry(order[rank]);
+    }
+    for (size_t id = 0; id < count; ++id) {
+        entry(static_cast<TermId>(id)) = entries[id];
+    }
+
+    for (size_t i = 0; i < (size_t(1) << SHARD_BITS); ++i) {
+        Shard& shard = shards[i];
+        Table* table = shard.table.load(std::memory_order_relaxed);
+        for (size_t position = 0; position <= table->mask; ++position) {
+            uint64_t slot = table->slots[position].load(std::memory_order_relaxed);
+            if (slot == 0) continue;
+            TermId id = renumbered[static_cast<TermId>(slot) - 1];
+            table->slots[position].store((slot & ~uint64_t(UINT32_MAX)) | (uint64_t(id) + 1),
+                                         std::memory_order_relaxed);
+        }
+
+        // Nobody can be probing outgrown tables any more
+        shard.tables.erase(std::remove_if(shard.tables.begin(), shard.tables.end(),
+                                          [&](const auto& owned) { return owned.get() != table; }),
+                           shard.tables.end());
+    }
+
+    finalizedSize = count;
+    return renumbered;
+}
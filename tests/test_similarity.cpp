@@ -1,10 +1,31 @@
 #include "../include/text_processor.hpp"
 #include "../include/similarity_calculator.hpp"
+#include "../include/shingling.hpp"
+#include "../include/result_writer.hpp"
+#include "../include/matrix_writer.hpp"
+#include "../include/simhash.hpp"
+#include "../include/sketch.hpp"
+#include "../include/hashing.hpp"
+#include "../include/ingest.hpp"
+#include "../include/bounded_queue.hpp"
+#include "../include/utf8.hpp"
+#include "../include/term_vector.hpp"
+#include "../include/corpus.hpp"
+#include "../include/external_join.hpp"
+#include "../include/sharding.hpp"
+#include "../include/top_k.hpp"
+#include "../include/clustering.hpp"
+#include "../include/vocabulary.hpp"
+#include "../include/sentence_index.hpp"
+#include "../include/inverted_index.hpp"
 #include <cassert>
 #include <iostream>
 #include <cmath>
 #include <fstream>
 #include <algorithm>
+#include <sstream>
+#include <cstring>
+#include <filesystem>
 
 void test_text_processing() {
     TextProcessor processor;
@@ -69,6 +90,1072 @@ void test_term_frequency() {
     std::cout << "✓ Term frequency test passed\n";
 }
 
+void test_result_writers() {
+    std::vector<std::string> names = {"a.txt", "b,c.txt", "d.txt"};
+    WriterOptions options;
+    options.fields = SCORE_COSINE | SCORE_JACCARD_WORD;
+    options.threshold = 0.5;
+    
+    PairRecord kept;
+    kept.doc1 = 0;
+    kept.doc2 = 1;
+    kept.cosine = 0.75;
+    kept.jaccardWord = 0.25;
+    PairRecord dropped;
+    dropped.doc1 = 0;
+    dropped.doc2 = 2;
+    dropped.cosine = 0.1;
+    
+    auto csv = ResultWriter::create(RecordFormat::CSV, "temp_results.csv", names, options);
+    bool wroteKept = csv->write(kept);
+    bool wroteDropped = csv->write(dropped);
+    assert(wroteKept);
+    assert(!wroteDropped); // Filtered before formatting
+    csv->finish();
+    
+    std::ifstream csvFile("temp_results.csv");
+    std::stringstream csvText;
+    csvText << csvFile.rdbuf();
+    assert(csvText.str() == "file1,file2,cosine,jaccard_word\na.txt,\"b,c.txt\",0.7500,0.2500\n");
+    std::remove("temp_results.csv");
+    
+    auto binary = ResultWriter::create(RecordFormat::BINARY, "temp_results.bin", names, options);
+    binary->write(kept);
+    binary->write(dropped);
+    binary->finish();
+    
+    BinaryResultReader reader("temp_results.bin");
+    assert(reader.header().names == names);
+    assert(reader.header().fields == options.fields);
+    PairRecord record;
+    bool found = reader.next(record);
+    assert(found);
+    assert(record.doc1 == 0 && record.doc2 == 1);
+    assert(std::abs(record.cosine - 0.75) < 0.001);
+    found = reader.next(record);
+    assert(!found);
+    
+    // The version field is stored little-endian on any host
+    std::ifstream rawFile("temp_results.bin", std::ios::binary);
+    char raw[8];
+    rawFile.read(raw, sizeof(raw));
+    assert(raw[4] == 1 && raw[5] == 0 && raw[6] == 0 && raw[7] == 0);
+    std::remove("temp_results.bin");
+    
+    // Failed writes surface from finish()
+    if (std::filesystem::exists("/dev/full")) {
+        auto full = ResultWriter::create(RecordFormat::CSV, "/dev/full", names, options);
+        full->write(kept);
+        bool threw = false;
+        try {
+            full->finish();
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+    }
+    
+    std::cout << "✓ Result writer test passed\n";
+}
+
+void test_matrix_writer() {
+    assert(MatrixWriter::toHalf(1.0f) == 0x3C00);
+    assert(MatrixWriter::toHalf(0.5f) == 0x3800);
+    assert(MatrixWriter::denseIndex(4, 0, 1) == 0);
+    assert(MatrixWriter::denseIndex(4, 1, 2) == 3);
+    assert(MatrixWriter::denseIndex(4, 2, 3) == 5);
+    
+    auto readAll = [](const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    };
+    
+    // Dense float32: 3 documents, 3 upper-triangular values
+    {
+        MatrixWriter dense("temp_matrix.bin", 3, MatrixDtype::FLOAT32, 0.0);
+        dense.set(1, 2, 0.25);
+        dense.set(0, 1, 0.75);
+        dense.set(0, 2, 0.5);
+        dense.finish();
+    }
+    std::string bytes = readAll("temp_matrix.bin");
+    MatrixFileHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    assert(std::memcmp(header.magic, "STXM", 4) == 0);
+    assert(header.n == 3 && header.nnz == 3 && header.itemSize == 4);
+    assert(bytes[4] == 1 && bytes[5] == 0 && bytes[16] == 3 && bytes[23] == 0); // Little-endian
+    assert(bytes.size() == header.dataOffset + 3 * sizeof(float));
+    float values[3];
+    std::memcpy(values, bytes.data() + header.dataOffset, sizeof(values));
+    assert(values[0] == 0.75f && values[1] == 0.5f && values[2] == 0.25f);
+    
+    // CSR: only scores at or above the threshold are stored
+    {
+        MatrixWriter sparse("temp_matrix.bin", 3, MatrixDtype::FLOAT32, 0.4);
+        sparse.set(0, 2, 0.5);
+        sparse.set(1, 2, 0.25);
+        sparse.set(0, 1, 0.75);
+        sparse.finish();
+    }
+    bytes = readAll("temp_matrix.bin");
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    assert(header.layout == static_cast<uint32_t>(MatrixLayout::CSR) && header.nnz == 2);
+    uint64_t indptr[4];
+    uint32_t indices[2];
+    std::memcpy(indptr, bytes.data() + header.indptrOffset, sizeof(indptr));
+    std::memcpy(indices, bytes.data() + header.indicesOffset, sizeof(indices));
+    std::memcpy(values, bytes.data() + header.dataOffset, 2 * sizeof(float));
+    assert(indptr[0] == 0 && indptr[1] == 2 && indptr[2] == 2 && indptr[3] == 2);
+    assert(indices[0] == 1 && indices[1] == 2);
+    assert(values[0] == 0.75f && values[1] == 0.5f);
+    std::remove("temp_matrix.bin");
+    
+    // Space that cannot be reserved is an error up front, not a SIGBUS later
+    bool threw = false;
+    try {
+        MatrixWriter full("/dev/full", 3, MatrixDtype::FLOAT32, 0.0);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    
+    std::cout << "✓ Matrix writer test passed\n";
+}
+
+void test_simhash() {
+    TextProcessor processor;
+    auto fp1 = SimHash::fingerprint(processor.getTermFrequencyMap(
+        "the quick brown fox jumps over the lazy dog near the river bank today"));
+    auto fp2 = SimHash::fingerprint(processor.getTermFrequencyMap(
+        "the quick brown fox jumps over the lazy dog near the river bank tonight"));
+    auto fp3 = SimHash::fingerprint(processor.getTermFrequencyMap(
+        "completely unrelated words about databases and query planners"));
+    
+    assert(SimHash::hammingDistance(fp1, fp1) == 0);
+    assert(SimHash::hammingDistance(fp1, fp2) < SimHash::hammingDistance(fp1, fp3));
+    
+    // Index results must match a brute-force scan, without duplicates
+    std::vector<uint64_t> fingerprints = {
+        0x0ULL, 0x7ULL, 0xF0ULL, 0x1ULL << 63, ~0x0ULL, 0x3ULL | (0x1ULL << 40), fp1, fp2, fp3};
+    const int k = 3;
+    std::vector<std::pair<uint32_t, uint32_t>> expected;
+    for (uint32_t i = 0; i < fingerprints.size(); ++i) {
+        for (uint32_t j = i + 1; j < fingerprints.size(); ++j) {
+            if (SimHash::hammingDistance(fingerprints[i], fingerprints[j]) <= k) {
+                expected.emplace_back(i, j);
+            }
+        }
+    }
+    
+    auto pairs = SimHash::findNearDuplicates(fingerprints, k);
+    assert(pairs.size() == expected.size());
+    for (size_t p = 0; p < pairs.size(); ++p) {
+        assert(pairs[p].doc1 == expected[p].first && pairs[p].doc2 == expected[p].second);
+    }
+    
+    SimHashIndex index(fingerprints, k);
+    auto matches = index.query(0x0ULL);
+    assert(matches.size() == 4); // 0x0, 0x7, 1<<63, 0x3|1<<40
+    assert(matches[0].first == 0 && matches[0].second == 0);
+    for (const auto& pair : pairs) {
+        auto found = index.query(fingerprints[pair.doc1]);
+        assert(std::count(found.begin(), found.end(), std::make_pair(pair.doc2, pair.distance)) == 1);
+    }
+    
+    std::cout << "✓ SimHash test passed\n";
+}
+
+void test_jaccard_sketches() {
+    // Two sets of 2000 elements sharing 1000: Jaccard = 1000 / 3000
+    auto minhash1 = MinHashSketch::forError(0.05);
+    auto minhash2 = minhash1;
+    auto hll1 = HyperLogLogSketch::forError(0.02);
+    auto hll2 = hll1;
+    for (uint64_t i = 0; i < 2000; ++i) {
+        minhash1.add(mix64(i));
+        minhash2.add(mix64(i + 1000));
+        hll1.add(mix64(i));
+        hll2.add(mix64(i + 1000));
+    }
+    minhash1.finalize();
+    minhash2.finalize();
+    
+    double exact = 1000.0 / 3000.0;
+    auto estimate = MinHashSketch::estimateJaccard(minhash1, minhash2);
+    assert(std::abs(estimate.value - exact) < 0.05);
+    assert(estimate.lower <= estimate.value && estimate.value <= estimate.upper);
+    assert(minhash1.serialize().size() < 512);
+    
+    auto hllEstimate = HyperLogLogSketch::estimateJaccard(hll1, hll2);
+    assert(std::abs(hllEstimate.value - exact) < 0.1);
+    
+    // Round trips preserve the estimate
+    auto restored = MinHashSketch::deserialize(minhash1.serialize());
+    auto again = MinHashSketch::estimateJaccard(restored, minhash2);
+    assert(again.value == estimate.value);
+    auto restoredHll = HyperLogLogSketch::deserialize(hll1.serialize());
+    assert(restoredHll.cardinality() == hll1.cardinality());
+    
+    // Bin counts are stored little-endian
+    std::string forged = minhash1.serialize();
+    assert(static_cast<uint8_t>(forged[5]) == (minhash1.bins() & 0xFF) &&
+           static_cast<uint8_t>(forged[6]) == (minhash1.bins() >> 8 & 0xFF));
+    
+    // A header claiming more bins than the data holds is rejected up front
+    forged[5] = forged[6] = forged[7] = forged[8] = static_cast<char>(0xFF);
+    bool rejected = false;
+    try {
+        MinHashSketch::deserialize(forged);
+    } catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    assert(rejected);
+    
+    // Identical documents stay identical, including densified bins
+    auto small1 = MinHashSketch::forError(0.05);
+    auto small2 = small1;
+    ShinglingCalculator::forEachCharacterShingle("short text", 3, [&](std::string_view shingle) {
+        small1.add(hashBytes(shingle.data(), shingle.size()));
+        small2.add(hashBytes(shingle.data(), shingle.size()));
+    });
+    small1.finalize();
+    small2.finalize();
+    assert(MinHashSketch::estimateJaccard(small1, small2).value == 1.0);
+    
+    // Sketched corpora keep finalized sketches in place of the shingle sources
+    CompareOptions options;
+    options.algorithm = Algorithm::JACCARD_CHAR;
+    options.sketch = SketchType::MINHASH;
+    Corpus corpus(options);
+    corpus.add("short text");
+    corpus.add("short text");
+    corpus.finalize();
+    const DocumentProfile& profile = corpus.profile(0);
+    assert(profile.content.empty() && profile.tokens.empty() && profile.tf.empty());
+    assert(profile.charSketch.minHash && !profile.wordSketch.minHash);
+    assert(corpus.compare(0, 1).jaccardChar == 1.0);
+    
+    std::cout << "✓ Jaccard sketch test passed\n";
+}
+
+void test_ingest_pipeline() {
+    // Queue keeps FIFO order for a single producer and consumer
+    BoundedQueue<int> queue(4);
+    for (int i = 0; i < 4; ++i) {
+        bool pushed = queue.push(i);
+        assert(pushed);
+    }
+    int value = -1;
+    bool pushed = queue.tryPush(value);
+    assert(!pushed); // Full
+    for (int i = 0; i < 4; ++i) {
+        bool popped = queue.pop(value);
+        assert(popped && value == i);
+    }
+    queue.close();
+    bool popped = queue.pop(value);
+    assert(!popped);
+    
+    std::filesystem::create_directories("temp_ingest/nested");
+    std::vector<std::string> expected;
+    for (int i = 0; i < 20; ++i) {
+        std::string path = (i % 2 ? "temp_ingest/nested/doc" : "temp_ingest/doc") +
+                           std::to_string(100 + i) + ".txt";
+        std::ofstream(path) << "document " << i;
+    }
+    
+    auto files = IngestPipeline::expandInputs({"temp_ingest"}, {});
+    assert(files.size() == 20);
+    assert(std::is_sorted(files.begin(), files.end()));
+    
+    // Tiny queue and byte budget force the readers to wait on the workers
+    IngestOptions options;
+    options.readers = 3;
+    options.workers = 4;
+    options.queueCapacity = 2;
+    options.maxBytesInFlight = 16;
+    std::vector<std::string> contents(files.size());
+    IngestPipeline(options).run(files, [&](size_t index, std::string&& content) {
+        contents[index] = std::move(content);
+    });
+    for (size_t i = 0; i < files.size(); ++i) {
+        assert(contents[i] == IngestPipeline::readFile(files[i]));
+    }
+    
+    bool threw = false;
+    try {
+        IngestPipeline(options).run({"temp_ingest/missing.txt"}, [](size_t, std::string&&) {});
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    
+    std::filesystem::remove_all("temp_ingest");
+    std::cout << "✓ Ingest pipeline test passed\n";
+}
+
+void test_utf8_tokenizer() {
+    assert(Utf8::toLowerCase("ÀÉÎ Straße ΣΟΦΙΑ Ёлка") == "àéî straße σοφια ёлка");
+    assert(Utf8::foldCase(0x0130) == 0x0130); // No simple folding for dotted I
+    assert(Utf8::toLowerCase("ȘTIINȚĂ ẞ Ǆ Ɛ") == "știință ß ǆ ɛ"); // Latin Extended-B, capital sharp s
+    assert(Utf8::foldCase(0xAB70) == 0x13A0); // Cherokee folds to its upper case
+    assert(Utf8::foldCase(0x1E900) == 0x1E922 && Utf8::foldCase(0x1E922) == 0x1E922); // Adlam
+    assert(Utf8::asciiPrefixLength("plain ascii text that is long é") == 30);
+    
+    // Invalid sequences decode to U+FFFD one byte at a time
+    std::string invalid = "\xC3\x28";
+    size_t pos = 0;
+    assert(Utf8::decode(invalid, pos) == 0xFFFD && pos == 1);
+    
+    TextProcessor processor;
+    auto tokens = processor.processText("«Ça VA?» Größe,  ΣΟΦΙΑ\u3000東京タワー。");
+    assert(tokens.size() == 5);
+    assert(tokens[0] == "ça");
+    assert(tokens[1] == "va");
+    assert(tokens[2] == "größe");
+    assert(tokens[3] == "σοφια");
+    assert(tokens[4] == "東京タワー");
+    
+    // Character shingles count code points, not bytes
+    auto shingles = ShinglingCalculator::generateCharacterShingles("東京タワー", 3);
+    assert(shingles.size() == 3);
+    assert(shingles.count("東京タ") == 1);
+    assert(ShinglingCalculator::calculateJaccardSimilarity(
+        ShinglingCalculator::generateCharacterShingles("CAFÉ au lait", 3),
+        ShinglingCalculator::generateCharacterShingles("café AU LAIT", 3)) == 1.0);
+    
+    std::cout << "✓ UTF-8 tokenizer test passed\n";
+}
+
+void test_packed_shingles() {
+    std::vector<std::string> texts = {
+        "The quick brown fox jumps over the lazy dog. The quick brown fox!",
+        "A quick brown fox is jumping over a lazy dog",
+        "Naïve café déjà vu, the quick brown fox",
+        "hi",
+        "",
+    };
+    
+    // Packed and hashed keys must give exactly the string-set Jaccard
+    for (int w = 1; w <= 10; ++w) {
+        for (const auto& a : texts) {
+            auto packedA = ShinglingCalculator::generatePackedCharacterShingles(a, w);
+            assert(std::is_sorted(packedA.begin(), packedA.end()));
+            assert(std::adjacent_find(packedA.begin(), packedA.end()) == packedA.end());
+            assert(packedA.size() == ShinglingCalculator::generateCharacterShingles(a, w).size());
+            
+            for (const auto& b : texts) {
+                auto packedB = ShinglingCalculator::generatePackedCharacterShingles(b, w);
+                double exact = ShinglingCalculator::calculateJaccardSimilarity(
+                    ShinglingCalculator::generateCharacterShingles(a, w),
+                    ShinglingCalculator::generateCharacterShingles(b, w));
+                assert(std::abs(ShinglingCalculator::calculateJaccardSimilarity(packedA, packedB) - exact) < 1e-12);
+            }
+        }
+    }
+    
+    // Radix path on inputs large enough to use it
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < 5000; ++i) keys.push_back(mix64(i % 1000));
+    auto expected = keys;
+    std::sort(expected.begin(), expected.end());
+    expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+    ShinglingCalculator::sortUnique(keys);
+    assert(keys == expected);
+    
+    std::cout << "✓ Packed shingles test passed\n";
+}
+
+void test_term_vectors() {
+    TextProcessor processor;
+    auto tf1 = processor.getTermFrequencyMap("the cat sat on the mat with another cat");
+    auto tf2 = processor.getTermFrequencyMap("a cat sat on a hat near the mat");
+    double exact = SimilarityCalculator::calculateCosineSimilarity(tf1, tf2);
+    
+    // Normalized float32 vectors agree with the double path to float precision
+    Vocabulary vocabulary;
+    auto v1 = TermVector::fromTermFrequencies(tf1, vocabulary);
+    auto v2 = TermVector::fromTermFrequencies(tf2, vocabulary);
+    assert(std::is_sorted(v1.keys.begin(), v1.keys.end()));
+    assert(std::abs(SimilarityCalculator::calculateCosineSimilarity(v1, v2) - exact) < 1e-6);
+    assert(SimilarityCalculator::calculateCosineSimilarity(v1, v1) <= 1.0);
+    assert(std::abs(SimilarityCalculator::calculateCosineSimilarity(v1, v1) - 1.0) < 1e-6);
+    
+    // Empty documents compare as 0 rather than NaN
+    TermVector empty = TermVector::fromTermFrequencies({}, vocabulary);
+    assert(SimilarityCalculator::calculateCosineSimilarity(v1, empty) == 0.0);
+    
+    // Corpus IDF vectors match the map-based TF-IDF cosine
+    auto tf3 = processor.getTermFrequencyMap("dogs chase cats");
+    auto idf = SimilarityCalculator::calculateIdf({tf1, tf2, tf3});
+    double exactTfIdf = SimilarityCalculator::calculateTfIdfCosineSimilarity(tf1, tf2, idf);
+    assert(std::abs(SimilarityCalculator::calculateCosineSimilarity(
+        TermVector::fromTfIdf(tf1, idf, vocabulary), TermVector::fromTfIdf(tf2, idf, vocabulary)) - exactTfIdf) < 1e-6);
+    
+    // Hashed vectors are exact when the buckets do not collide
+    auto h1 = HashedVector::fromTermFrequencies(tf1, 1 << 16);
+    auto h2 = HashedVector::fromTermFrequencies(tf2, 1 << 16);
+    assert(std::abs(SimilarityCalculator::calculateCosineSimilarity(h1, h2) - exact) < 1e-5);
+    HashedVector opposite1, opposite2;
+    opposite1.values = {1.0f, 0.0f};
+    opposite2.values = {-1.0f, 0.0f};
+    assert(SimilarityCalculator::calculateCosineSimilarity(opposite1, opposite2) == 0.0);
+    
+    // Dispatched kernel matches the scalar one, including odd tails
+    std::vector<float> a(1003), b(1003);
+    for (size_t i = 0; i < a.size(); ++i) {
+        a[i] = static_cast<float>(std::sin(i * 0.1));
+        b[i] = static_cast<float>(std::cos(i * 0.3));
+    }
+    for (size_t size : {0, 1, 7, 8, 15, 16, 17, 1003}) {
+        float expected = VectorKernels::dotScalar(a.data(), b.data(), size);
+        assert(std::abs(VectorKernels::dot(a.data(), b.data(), size) - expected) < 1e-3f);
+    }
+    
+    std::cout << "✓ Term vector test passed (" << VectorKernels::activeKernel() << " kernel)\n";
+}
+
+void test_corpus_api() {
+    CompareOptions options;
+    options.algorithm = Algorithm::ALL;
+    Corpus corpus(options);
+    auto a = corpus.add("The quick brown fox jumps over the lazy dog");
+    auto b = corpus.add("The quick brown fox leaps over the lazy dog");
+    auto c = corpus.add("Completely unrelated text about databases");
+    corpus.finalize();
+    assert(corpus.size() == 3 && a == 0 && c == 2);
+    
+    // Same scores as the underlying calculators
+    TextProcessor processor;
+    double cosine = SimilarityCalculator::calculateCosineSimilarity(
+        processor.getTermFrequencyMap("The quick brown fox jumps over the lazy dog"),
+        processor.getTermFrequencyMap("The quick brown fox leaps over the lazy dog"));
+    SimilarityResult ab = corpus.compare(a, b);
+    assert(std::abs(ab.cosine - cosine) < 1e-6);
+    assert(ab.jaccardChar > corpus.compare(a, c).jaccardChar);
+    
+    // Batch comparisons skip self pairs and match single ones, with or without a pool
+    ThreadExecutor executor(3);
+    auto serial = corpus.compare({a, b, c}, {a, b, c});
+    auto parallel = corpus.compare({a, b, c}, {a, b, c}, &executor);
+    assert(serial.size() == 6 && parallel.size() == 6);
+    for (size_t i = 0; i < serial.size(); ++i) {
+        assert(serial[i].doc1 != serial[i].doc2);
+        assert(serial[i].doc1 == parallel[i].doc1 && serial[i].doc2 == parallel[i].doc2);
+        assert(serial[i].result.jaccardWord == parallel[i].result.jaccardWord);
+    }
+    
+    auto top = corpus.topK("a quick brown fox jumps over a lazy dog", 2, &executor);
+    assert(top.size() == 2 && top[0].document == a && top[1].document == b);
+    assert(top[0].score >= top[1].score);
+    
+    // Queries never add terms, but unknown ones still lower their cosine
+    size_t terms = corpus.vocabulary().size();
+    auto unknown = corpus.topK("The quick brown fox jumps over the lazy dog zebra", 1);
+    assert(corpus.vocabulary().size() == terms && !corpus.vocabulary().provisional());
+    assert(unknown[0].document == a && unknown[0].result.cosine < 0.99);
+    
+    // Corpus IDF needs finalize() after documents are added
+    options.algorithm = Algorithm::TFIDF;
+    options.corpusIdf = true;
+    Corpus idfCorpus(options);
+    idfCorpus.add("apples and oranges");
+    idfCorpus.add("apples and pears");
+    bool threw = false;
+    try {
+        idfCorpus.compare(0, 1);
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    assert(threw);
+    idfCorpus.add("bananas");
+    idfCorpus.finalize();
+    assert(idfCorpus.compare(0, 1).tfidf > 0.0);
+    
+    // Profiles live in the caller's memory resource
+    std::pmr::monotonic_buffer_resource arena;
+    Corpus arenaCorpus(CompareOptions(), TextProcessor(), &arena);
+    arenaCorpus.add("memory resource");
+    assert(arenaCorpus.profile(0).tokens.size() == 2);
+    
+    std::cout << "✓ Corpus API test passed\n";
+}
+
+void test_external_jaccard() {
+    // Enough postings and pairs under a 1 MiB budget to need many runs and
+    // a multi-pass merge
+    const uint32_t docs = 200;
+    std::vector<std::vector<uint64_t>> sets(docs);
+    for (uint32_t d = 0; d < docs; ++d) {
+        for (uint64_t k = 0; k < 500; ++k) sets[d].push_back(mix64(d * 1000 + k) % 1000);
+        ShinglingCalculator::sortUnique(sets[d]);
+    }
+    sets[7].clear(); // shares nothing, so never reported
+    
+    ExternalOptions options;
+    options.maxMemory = 1 << 20;
+    options.showProgress = false;
+    std::vector<std::pair<uint64_t, double>> reported;
+    {
+        ExternalJaccard join(docs, options);
+        for (uint32_t d = 0; d < docs; ++d) join.addDocument(d, sets[d]);
+        join.run([&](uint32_t doc1, uint32_t doc2, double jaccard) {
+            reported.emplace_back(static_cast<uint64_t>(doc1) << 32 | doc2, jaccard);
+        });
+    }
+    
+    std::vector<std::pair<uint64_t, double>> expected;
+    for (uint32_t i = 0; i < docs; ++i) {
+        for (uint32_t j = i + 1; j < docs; ++j) {
+            double jaccard = ShinglingCalculator::calculateJaccardSimilarity(sets[i], sets[j]);
+            if (jaccard > 0.0) expected.emplace_back(static_cast<uint64_t>(i) << 32 | j, jaccard);
+        }
+    }
+    assert(reported.size() == expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        assert(reported[i].first == expected[i].first);
+        assert(std::abs(reported[i].second - expected[i].second) < 1e-12);
+    }
+    
+    // A document-frequency cap scores pairs over the shingles it keeps
+    std::vector<std::vector<uint64_t>> capped = {{1, 2, 3, 9}, {2, 3, 4, 9}, {5, 9}, {6}};
+    options.maxDocumentFrequency = 2;
+    std::vector<std::pair<uint64_t, double>> cappedPairs;
+    {
+        ExternalJaccard join(capped.size(), options);
+        for (uint32_t d = 0; d < capped.size(); ++d) join.addDocument(d, capped[d]);
+        join.run([&](uint32_t doc1, uint32_t doc2, double jaccard) {
+            cappedPairs.emplace_back(static_cast<uint64_t>(doc1) << 32 | doc2, jaccard);
+        });
+    }
+    assert(cappedPairs.size() == 1 && cappedPairs[0].first == 1); // {1,2,3} vs {2,3,4}
+    assert(std::abs(cappedPairs[0].second - 0.5) < 1e-12);
+    
+    std::cout << "✓ External Jaccard test passed\n";
+}
+
+void test_sharding() {
+    // Shards cover every pair exactly once, in order, with sizes within one
+    for (uint64_t docs : {0, 1, 2, 5, 37}) {
+        for (uint32_t count : {1u, 2u, 3u, 7u, 50u}) {
+            std::vector<std::pair<uint32_t, uint32_t>> seen;
+            uint64_t smallest = UINT64_MAX, largest = 0;
+            for (uint32_t index = 0; index < count; ++index) {
+                Shard shard{index, count};
+                size_t before = seen.size();
+                PairPartition::forEachPair(docs, shard, [&](uint32_t i, uint32_t j) { seen.emplace_back(i, j); });
+                smallest = std::min<uint64_t>(smallest, seen.size() - before);
+                largest = std::max<uint64_t>(largest, seen.size() - before);
+            }
+            std::vector<std::pair<uint32_t, uint32_t>> expected;
+            for (uint32_t i = 0; i < docs; ++i) {
+                for (uint32_t j = i + 1; j < docs; ++j) expected.emplace_back(i, j);
+            }
+            assert(seen == expected);
+            assert(largest - smallest <= 1);
+        }
+    }
+    assert(PairPartition::pairAt(2000000, PairPartition::pairCount(2000000) - 1) ==
+           std::make_pair(uint32_t(1999998), uint32_t(1999999)));
+    Shard parsed = Shard::parse("2/5");
+    assert(parsed.index == 2 && parsed.count == 5);
+    
+    // Top-K keeps the best scores, ties broken by pair order
+    TopK<int> best(3);
+    best.push(0.5, 0, 1, 1);
+    best.push(0.9, 0, 2, 2);
+    best.push(0.5, 0, 3, 3);
+    best.push(0.1, 0, 4, 4);
+    best.push(0.5, 1, 2, 5);
+    auto kept = best.take();
+    assert(kept.size() == 3 && kept[0].value == 2 && kept[1].value == 1 && kept[2].value == 3);
+    
+    // Merging shard files reproduces the single-run file
+    std::vector<std::string> names = {"a", "b", "c", "d", "e", "f"};
+    WriterOptions options;
+    options.fields = SCORE_COSINE;
+    auto scoreOf = [](uint32_t i, uint32_t j) { return ((i * 7 + j * 3) % 10) / 10.0; };
+    auto writeShard = [&](const std::string& path, const Shard& shard) {
+        auto writer = ResultWriter::create(RecordFormat::BINARY, path, names, options);
+        PairPartition::forEachPair(names.size(), shard, [&](uint32_t i, uint32_t j) {
+            PairRecord record;
+            record.doc1 = i;
+            record.doc2 = j;
+            record.cosine = scoreOf(i, j);
+            writer->write(record);
+        });
+        writer->finish();
+    };
+    writeShard("test_single.bin", Shard());
+    writeShard("test_shard0.bin", Shard{0, 2});
+    writeShard("test_shard1.bin", Shard{1, 2});
+    
+    MergeOptions merge;
+    merge.outputFile = "test_merged.bin";
+    size_t merged = ShardMerger::merge({"test_shard1.bin", "test_shard0.bin"}, merge);
+    assert(merged == 15);
+    auto readAll = [](const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    };
+    assert(readAll("test_merged.bin") == readAll("test_single.bin"));
+    
+    merge.topK = 2;
+    merged = ShardMerger::merge({"test_shard0.bin", "test_shard1.bin"}, merge);
+    assert(merged == 2);
+    BinaryResultReader reader("test_merged.bin");
+    PairRecord first, second;
+    bool found = reader.next(first) && reader.next(second);
+    assert(found);
+    assert(std::abs(first.cosine - 0.9) < 1e-6 && first.doc1 == 0 && first.doc2 == 3);
+    assert(std::abs(second.cosine - 0.9) < 1e-6 && second.doc1 == 1 && second.doc2 == 4);
+    
+    // A best-first top-K shard only merges with a top-K
+    {
+        auto writer = ResultWriter::create(RecordFormat::BINARY, "test_shard0.bin", names, options);
+        for (auto [i, j] : {std::make_pair(1u, 4u), std::make_pair(0u, 3u)}) {
+            PairRecord record;
+            record.doc1 = i;
+            record.doc2 = j;
+            record.cosine = scoreOf(i, j);
+            writer->write(record);
+        }
+        writer->finish();
+    }
+    merged = ShardMerger::merge({"test_shard0.bin"}, merge);
+    assert(merged == 2);
+    merge.topK = 0;
+    bool rejected = false;
+    try {
+        ShardMerger::merge({"test_shard0.bin"}, merge);
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    assert(rejected);
+    
+    for (const char* path : {"test_single.bin", "test_shard0.bin", "test_shard1.bin", "test_merged.bin"}) {
+        std::remove(path);
+    }
+    
+    std::cout << "✓ Sharding test passed\n";
+}
+
+void test_scoring_cascade() {
+    CompareOptions options;
+    options.algorithm = Algorithm::ALL;
+    options.sentences = true;
+    Corpus full(options);
+    options.cascade = 0.5;
+    Corpus cascaded(options);
+    
+    std::vector<std::string> texts = {
+        "The committee approved the budget. The vote was unanimous.",
+        "The committee approved the budget. The vote was nearly unanimous.",
+        "Penguins huddle together to survive the antarctic winter.",
+    };
+    for (const auto& text : texts) {
+        full.add(text);
+        cascaded.add(text);
+    }
+    
+    // Near-duplicates run every stage and score exactly as without a cascade
+    SimilarityResult close = cascaded.compare(0, 1);
+    SimilarityResult closeFull = full.compare(0, 1);
+    assert(close.skipped == 0);
+    assert(close.jaccardWord == closeFull.jaccardWord && close.tfidf == closeFull.tfidf);
+    assert(close.sentenceSimilarities.size() == closeFull.sentenceSimilarities.size());
+    
+    // Unrelated texts stop early; what did run is unchanged
+    SimilarityResult far = cascaded.compare(0, 2);
+    SimilarityResult farFull = full.compare(0, 2);
+    assert(far.skipped & STAGE_SENTENCES);
+    assert(far.skipped & STAGE_JACCARD_WORD);
+    assert(!(far.skipped & STAGE_COSINE));
+    assert(far.cosine == farFull.cosine && far.sentenceSimilarities.empty());
+    
+    // A primary-score threshold stops pairs the combined score alone would keep
+    options.cascade = 0.0;
+    options.primaryThreshold = 0.5;
+    Corpus thresholded(options);
+    for (const auto& text : texts) thresholded.add(text);
+    assert(thresholded.compare(0, 1).skipped == 0);
+    assert(thresholded.compare(0, 2).skipped & STAGE_JACCARD_CHAR);
+    
+    // Skipped scores survive a binary round trip as NaN
+    PairRecord record;
+    record.doc1 = 0;
+    record.doc2 = 1;
+    record.cosine = 0.25;
+    record.skipped = SCORE_JACCARD_WORD;
+    WriterOptions writerOptions;
+    writerOptions.fields = SCORE_COSINE | SCORE_JACCARD_WORD;
+    auto writer = ResultWriter::create(RecordFormat::BINARY, "test_cascade.bin", {"a", "b"}, writerOptions);
+    writer->write(record);
+    writer->finish();
+    BinaryResultReader reader("test_cascade.bin");
+    PairRecord read;
+    bool found = reader.next(read);
+    assert(found);
+    assert(read.skipped == SCORE_JACCARD_WORD && read.jaccardWord == 0.0 && read.cosine == 0.25);
+    std::remove("test_cascade.bin");
+    
+    std::cout << "✓ Scoring cascade test passed\n";
+}
+
+void test_clustering() {
+    // Sets end up rooted at their smallest member whatever the union order
+    ConcurrentUnionFind sets(6);
+    bool merged5 = sets.unite(5, 4);
+    bool merged4 = sets.unite(4, 2);
+    bool merged2 = sets.unite(2, 5);
+    assert(merged5 && merged4 && !merged2);
+    assert(sets.find(5) == 2 && sets.find(4) == 2 && sets.find(0) == 0);
+    
+    // Concurrent unions of a chain give one set
+    const uint32_t n = 2000;
+    ConcurrentUnionFind chain(n);
+    ThreadExecutor executor(4);
+    executor.parallelFor(n - 1, [&](size_t i) {
+        chain.unite(static_cast<uint32_t>(n - 1 - i), static_cast<uint32_t>(n - 2 - i));
+    });
+    for (uint32_t i = 0; i < n; ++i) assert(chain.find(i) == 0);
+    
+    // 0-1-2 linked, 3 alone (below threshold), 4-5 linked
+    ClusterBuilder builder(6, 0.5);
+    std::vector<bool> kept = {
+        builder.addPair(0, 1, 0.9),
+        builder.addPair(1, 2, 0.6),
+        builder.addPair(0, 2, 0.7),
+        builder.addPair(2, 3, 0.4),
+        builder.addPair(4, 5, 1.0)
+    };
+    assert((kept == std::vector<bool>{true, true, true, false, true}));
+    auto clusters = builder.clusters();
+    assert(clusters.size() == 2);
+    assert((clusters[0].members == std::vector<uint32_t>{0, 1, 2}));
+    assert(clusters[0].pairs == 3);
+    assert(clusters[0].representative == 0); // 0.9 + 0.7 beats 1.5 and 1.3
+    assert(std::abs(clusters[0].minScore - 0.6) < 1e-12 && std::abs(clusters[0].maxScore - 0.9) < 1e-12);
+    assert(std::abs(clusters[0].meanScore - 2.2 / 3) < 1e-12);
+    assert((clusters[1].members == std::vector<uint32_t>{4, 5}));
+    
+    ClusterWriter::write(clusters, {"a", "b", "c", "d", "e", "f"}, ClusterFormat::CSV,
+                         "test_clusters.csv", false);
+    std::ifstream file("test_clusters.csv");
+    std::stringstream contents;
+    contents << file.rdbuf();
+    assert(contents.str() == "cluster,file\n0,a\n0,b\n0,c\n1,e\n1,f\n");
+    file.close();
+    std::remove("test_clusters.csv");
+    
+    std::cout << "✓ Clustering test passed\n";
+}
+
+void test_vocabulary() {
+    // Many threads interning overlapping terms, enough to grow every shard
+    std::vector<std::string> terms;
+    for (int i = 0; i < 5000; ++i) terms.push_back("term" + std::to_string(i * 7919 % 5000));
+    terms.push_back(std::string(100000, 'x')); // bigger than an arena block
+    
+    auto internAll = [&](size_t threads) {
+        auto vocabulary = std::make_unique<Vocabulary>(16);
+        std::vector<Vocabulary::TermId> ids(terms.size() * 4);
+        ThreadExecutor executor(threads);
+        executor.parallelFor(ids.size(), [&](size_t i) {
+            // Each thread count starts at a different term
+            size_t term = (i + threads * 1237) % terms.size();
+            ids[i] = vocabulary->intern(terms[term]);
+            assert(vocabulary->term(ids[i]) == terms[term]);
+        });
+        assert(vocabulary->size() == terms.size());
+        assert(vocabulary->provisional());
+        
+        auto renumbered = vocabulary->finalize();
+        assert(!vocabulary->provisional());
+        std::vector<Vocabulary::TermId> finalIds;
+        for (const auto& term : terms) {
+            Vocabulary::TermId id = 0;
+            bool found = vocabulary->find(term, id);
+            assert(found);
+            finalIds.push_back(id);
+        }
+        for (size_t i = 0; i < ids.size(); ++i) {
+            size_t term = (i + threads * 1237) % terms.size();
+            assert(renumbered[ids[i]] == finalIds[term]);
+        }
+        return std::make_pair(std::move(vocabulary), finalIds);
+    };
+    
+    // Final ids follow term order, whatever the thread count
+    auto [serial, serialIds] = internAll(1);
+    auto [parallel, parallelIds] = internAll(8);
+    assert(serialIds == parallelIds);
+    for (Vocabulary::TermId id = 1; id < serial->size(); ++id) {
+        assert(serial->term(id - 1) < serial->term(id));
+    }
+    Vocabulary::TermId missing;
+    bool found = serial->find("absent", missing);
+    assert(!found);
+    
+    // Corpus term vectors do not depend on the order documents were built in
+    std::vector<std::string> texts = {"red green blue", "blue yellow red", "green cyan magenta"};
+    Corpus forward, backward;
+    std::vector<DocumentProfile> profiles(texts.size());
+    for (size_t i = texts.size(); i-- > 0;) profiles[i] = backward.buildProfile(std::string(texts[i]));
+    for (size_t i = 0; i < texts.size(); ++i) {
+        forward.add(texts[i]);
+        backward.add(std::move(profiles[i]));
+    }
+    forward.finalize();
+    backward.finalize();
+    for (Corpus::DocumentId i = 0; i < texts.size(); ++i) {
+        assert(forward.profile(i).termVector.keys == backward.profile(i).termVector.keys);
+        assert(forward.profile(i).termVector.weights == backward.profile(i).termVector.weights);
+    }
+    assert(forward.compare(0, 1).cosine == backward.compare(0, 1).cosine);
+    
+    std::cout << "✓ Vocabulary test passed\n";
+}
+
+void test_sentence_index() {
+    // Spans point at trimmed sentences in the original text
+    std::string text = "  First sentence here!  Second one?? ok. Third sentence follows";
+    auto spans = DocumentAnalyzer::findSentences(text);
+    assert(spans.size() == 3);
+    assert(text.substr(spans[0].first, spans[0].second) == "First sentence here");
+    assert(text.substr(spans[1].first, spans[1].second) == "Second one");
+    assert(text.substr(spans[2].first, spans[2].second) == "Third sentence follows");
+    
+    std::vector<std::string> documents = {
+        "Cats sleep for most of the day in warm places. Dogs prefer long walks in the park.",
+        "The committee approved the annual budget after a long debate. Rain is expected tomorrow.",
+        "Nothing in here matches anything else at all. Dogs prefer long walks in the park."
+    };
+    SentenceIndex index;
+    ThreadExecutor executor(3);
+    executor.parallelFor(documents.size(), [&](size_t i) {
+        index.addDocument(static_cast<uint32_t>(i), documents[i]);
+    });
+    assert(index.sentenceCount() == 6);
+    
+    std::string query = "Honestly, the committee approved the annual budget after a long debate. "
+                        "Dogs prefer long walks in the park. Quantum gardening is a new hobby.";
+    auto matches = index.query(query);
+    assert(matches.size() == 2);
+    
+    // An edited copy still finds its source, with the offset of the original
+    assert(matches[0].sources.size() == 1);
+    assert(matches[0].sources[0].document == 1 && matches[0].sources[0].offset == 0);
+    assert(matches[0].sources[0].similarity > 0.7 && matches[0].sources[0].similarity < 1.0);
+    
+    // Exact copies in two documents come out in document order
+    const auto& dogs = matches[1];
+    assert(query.substr(dogs.offset, dogs.length) == "Dogs prefer long walks in the park");
+    assert(dogs.sources.size() == 2);
+    assert(dogs.sources[0].document == 0 && dogs.sources[1].document == 2);
+    assert(dogs.sources[0].similarity == 1.0);
+    assert(documents[0].substr(dogs.sources[0].offset, dogs.sources[0].length) == "Dogs prefer long walks in the park");
+    
+    SentenceIndexOptions options;
+    options.maxSources = 1;
+    SentenceIndex limited(options);
+    for (size_t i = 0; i < documents.size(); ++i) limited.addDocument(static_cast<uint32_t>(i), documents[i]);
+    assert(limited.query(query)[1].sources.size() == 1);
+    
+    std::cout << "✓ Sentence index test passed\n";
+}
+
+void test_inverted_index() {
+    // Skewed word frequencies, like real text, over enough documents for
+    // multi-block posting lists
+    std::vector<std::string> texts;
+    uint64_t state = 42;
+    auto nextWord = [&]() {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        double u = static_cast<double>(state >> 11) / (1ULL << 53);
+        return "w" + std::to_string(static_cast<int>(std::pow(2000.0, u)));
+    };
+    for (int doc = 0; doc < 600; ++doc) {
+        std::string text;
+        for (int word = 0; word < 40; ++word) text += nextWord() + " ";
+        texts.push_back(text);
+    }
+    
+    CompareOptions options;
+    options.algorithm = Algorithm::TFIDF;
+    options.corpusIdf = true;
+    options.searchIndex = true;
+    Corpus corpus(options);
+    for (const auto& text : texts) corpus.add(text);
+    corpus.finalize();
+    
+    // Same documents and scores as scoring every document
+    for (const std::string& query : {texts[7], texts[123] + texts[321], std::string("w1500 w1700 w1999 w3")}) {
+        for (size_t k : {1, 5, 50}) {
+            SearchStats stats;
+            auto indexed = corpus.search(query, k, &stats);
+            auto scanned = corpus.topK(query, k);
+            assert(indexed.size() == k);
+            for (size_t i = 0; i < k; ++i) {
+                assert(indexed[i].document == scanned[i].document);
+                assert(indexed[i].score == scanned[i].score);
+            }
+            assert(stats.postingsDecoded <= stats.postings);
+            assert(stats.documentsScored <= corpus.size());
+        }
+    }
+    
+    // A rare-term query scores few documents
+    SearchStats stats;
+    auto rare = corpus.search("w1999 w1998", 3, &stats);
+    assert(rare.size() <= 3);
+    assert(stats.documentsScored < 20);
+    
+    // Documents sharing no term never match, and search needs the index
+    assert(corpus.search("unseen words only", 5).empty());
+    Corpus plain;
+    plain.add("no index here");
+    plain.finalize();
+    bool threw = false;
+    try {
+        plain.search("index", 1);
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    assert(threw);
+    
+    std::cout << "✓ Inverted index test passed\n";
+}
+
+void test_parallel_chunking() {
+    // Skewed vocabulary with punctuation, repeated spaces, line breaks and
+    // multi-byte characters; over 64K tokens so counting runs in ranges
+    uint64_t state = 11;
+    auto next = [&]() { return state = mix64(state); };
+    const char* forms[] = {"w%", "W%,", "é%!!", "Θ%...", "%?", "\"%\"", "zß%", "%-x"};
+    std::string text;
+    for (int i = 0; i < 160000; ++i) {
+        std::string word = forms[next() % 8];
+        word.replace(word.find('%'), 1, std::to_string(next() % (1 + next() % 20000)));
+        text += word;
+        uint64_t gap = next() % 16;
+        text += gap == 0 ? "\n" : gap == 1 ? "  " : gap == 2 ? "\t" : " ";
+    }
+    assert(text.size() > (1 << 20));
+    std::string ascii;
+    for (char c : text) ascii += static_cast<unsigned char>(c) < 0x80 ? c : 'a';
+    
+    ThreadExecutor executor(4);
+    TextProcessor processor;
+    for (const std::string* sample : {&text, &ascii}) {
+        auto tokens = processor.processText(*sample);
+        assert(processor.processText(*sample, executor, 4096) == tokens);
+        
+        // Equal entries in the same iteration order
+        auto tf = TextProcessor::getTermFrequencyMap(tokens);
+        auto parallelTf = TextProcessor::getTermFrequencyMap(tokens, executor);
+        assert(std::equal(tf.begin(), tf.end(), parallelTf.begin(), parallelTf.end()));
+        
+        for (int w : {3, 5, 8, 11}) {
+            assert(ShinglingCalculator::generatePackedCharacterShingles(*sample, w, executor, 4096) ==
+                   ShinglingCalculator::generatePackedCharacterShingles(*sample, w));
+        }
+        
+        auto wordShingles = ShinglingCalculator::generateSortedWordShingles(tokens, 3);
+        auto wordSet = ShinglingCalculator::generateWordShingles(tokens, 3);
+        assert(std::equal(wordShingles.begin(), wordShingles.end(), wordSet.begin(), wordSet.end()));
+        assert(ShinglingCalculator::generateSortedWordShingles(tokens, 3, executor, 1000) == wordShingles);
+        
+        DocumentStats serial = DocumentAnalyzer::analyzeDocument(*sample, tokens);
+        DocumentStats parallel = DocumentAnalyzer::analyzeDocument(*sample, tokens, executor, 4096);
+        assert(parallel.sentenceCount == serial.sentenceCount);
+        assert(parallel.uniqueWords == serial.uniqueWords);
+        assert(parallel.lexicalDiversity == serial.lexicalDiversity);
+    }
+    
+    // Texts too short to cut, or to hold one shingle, go through whole
+    for (const std::string& small : {std::string(), std::string("ab"), std::string("  a  b  ")}) {
+        assert(processor.processText(small, executor, 1) == processor.processText(small));
+        assert(ShinglingCalculator::generatePackedCharacterShingles(small, 5, executor, 1) ==
+               ShinglingCalculator::generatePackedCharacterShingles(small, 5));
+    }
+    
+    // Profiles of documents over the chunk size compare the same either way
+    CompareOptions options;
+    options.algorithm = Algorithm::ALL;
+    options.analysis = true;
+    Corpus serialCorpus(options), parallelCorpus(options);
+    std::string other = text.substr(text.size() / 3) + ascii.substr(0, text.size() / 3);
+    for (const std::string* document : {&text, &other}) {
+        serialCorpus.add(serialCorpus.buildProfile(std::string(*document)));
+        parallelCorpus.add(parallelCorpus.buildProfile(std::string(*document), &executor));
+    }
+    serialCorpus.finalize();
+    parallelCorpus.finalize();
+    SimilarityResult expected = serialCorpus.compare(0, 1);
+    SimilarityResult actual = parallelCorpus.compare(0, 1);
+    assert(actual.cosine == expected.cosine);
+    assert(actual.tfidf == expected.tfidf);
+    assert(actual.jaccardChar == expected.jaccardChar);
+    assert(actual.jaccardWord == expected.jaccardWord);
+    assert(actual.stats1.uniqueWords == expected.stats1.uniqueWords);
+    
+    std::cout << "✓ Parallel chunking test passed\n";
+}
+
+void test_compare_batched() {
+    std::vector<std::string> texts;
+    uint64_t state = 5;
+    for (int doc = 0; doc < 60; ++doc) {
+        std::string text;
+        for (int word = 0; word < 30; ++word) {
+            state = mix64(state);
+            text += "w" + std::to_string(state % 90) + " ";
+        }
+        texts.push_back(text);
+    }
+    
+    CompareOptions options;
+    options.algorithm = Algorithm::ALL;
+    Corpus corpus(options);
+    for (const auto& text : texts) corpus.add(text);
+    corpus.finalize();
+    
+    // Queries overlap the documents to check that self pairs are skipped
+    std::vector<Corpus::DocumentId> queries = {0, 1, 2, 3, 4, 5, 6};
+    std::vector<Corpus::DocumentId> documents;
+    for (Corpus::DocumentId id = 5; id < corpus.size(); ++id) documents.push_back(id);
+    
+    ThreadExecutor executor(3);
+    for (size_t batchSize : {1, 3, 100}) {
+        for (Executor* pool : {static_cast<Executor*>(nullptr), static_cast<Executor*>(&executor)}) {
+            std::vector<Corpus::Comparison> seen;
+            corpus.compareBatched(queries, documents, batchSize,
+                                  [&](const Corpus::Comparison& pair) { seen.push_back(pair); }, pool);
+            
+            // Batch by batch, then by document, then by query
+            size_t next = 0;
+            for (size_t batch = 0; batch < queries.size(); batch += batchSize) {
+                for (auto doc : documents) {
+                    for (size_t q = batch; q < std::min(queries.size(), batch + batchSize); ++q) {
+                        if (queries[q] == doc) continue;
+                        assert(next < seen.size());
+                        assert(seen[next].doc1 == queries[q] && seen[next].doc2 == doc);
+                        SimilarityResult expected = corpus.compare(queries[q], doc);
+                        assert(seen[next].result.cosine == expected.cosine);
+                        assert(seen[next].result.jaccardWord == expected.jaccardWord);
+                        ++next;
+                    }
+                }
+            }
+            assert(next == seen.size());
+            assert(seen.size() == queries.size() * documents.size() - 2);
+        }
+    }
+    
+    std::cout << "✓ Batched comparison test passed\n";
+}
+
 int main() {
     std::cout << "Running SimText tests...\n\n";
     
@@ -77,6 +1164,24 @@ int main() {
         test_stopwords_filtering();
         test_cosine_similarity();
         test_term_frequency();
+        test_result_writers();
+        test_matrix_writer();
+        test_simhash();
+        test_jaccard_sketches();
+        test_ingest_pipeline();
+        test_utf8_tokenizer();
+        test_packed_shingles();
+        test_term_vectors();
+        test_corpus_api();
+        test_external_jaccard();
+        test_sharding();
+        test_scoring_cascade();
+        test_clustering();
+        test_vocabulary();
+        test_sentence_index();
+        test_inverted_index();
+        test_parallel_chunking();
+        test_compare_batched();
         
         std::cout << "\n✅ All tests passed!\n";
         return 0;